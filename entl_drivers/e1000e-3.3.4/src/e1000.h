@@ -176,6 +176,8 @@ struct e1000_buffer {
 			/* arrays of page information for packet split */
 			struct e1000_ps_page *ps_pages;
 			struct page *page;
+			/* ENTL page recycling, half page in use */
+			unsigned int page_offset;
 		};
 	};
 };
@@ -0,0 +1,281 @@
+/*
+ * ENTT AIT shared-memory rings
+ * Copyright(c) 2016 Earth Computing.
+ *
+ *   One pair of rings per port lets the user post and reap AIT messages without an ioctl per message.
+ *   Send ring entries are handed to the state machine in place, so there is no copy or kzalloc on send.
+ */
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/netdevice.h>
+
+#include "entl_ait_ring.h"
+
+#define ENTT_RING_MASK (ENTT_RING_SIZE - 1)
+
+static void entt_ait_ring_buf_free( struct kref *ref )
+{
+	entt_ait_ring_buf_t *buf = container_of( ref, entt_ait_ring_buf_t, ref ) ;
+
+	vfree( buf->map ) ;
+	kfree( buf ) ;
+}
+
+static void entt_ait_ring_buf_put( entt_ait_ring_buf_t *buf )
+{
+	kref_put( &buf->ref, entt_ait_ring_buf_free ) ;
+}
+
+static void entt_ait_ring_vm_open( struct vm_area_struct *vma )
+{
+	entt_ait_ring_buf_t *buf = vma->vm_private_data ;
+
+	kref_get( &buf->ref ) ;
+}
+
+static void entt_ait_ring_vm_close( struct vm_area_struct *vma )
+{
+	entt_ait_ring_buf_put( vma->vm_private_data ) ;
+}
+
+static const struct vm_operations_struct entt_ait_ring_vm_ops = {
+	.open = entt_ait_ring_vm_open,
+	.close = entt_ait_ring_vm_close,
+} ;
+
+static int entt_ait_ring_open( struct inode *inode, struct file *file )
+{
+	// misc_open sets private_data to our miscdevice and calls us with misc_mtx held,
+	//   so misc_deregister in entt_ait_ring_destroy waits for this and ring->buf is still there
+	entt_ait_ring_t *ring = container_of( file->private_data, entt_ait_ring_t, misc ) ;
+
+	kref_get( &ring->buf->ref ) ;
+	file->private_data = ring->buf ;
+	return 0 ;
+}
+
+static int entt_ait_ring_release( struct inode *inode, struct file *file )
+{
+	entt_ait_ring_buf_put( file->private_data ) ;
+	return 0 ;
+}
+
+static int entt_ait_ring_mmap( struct file *file, struct vm_area_struct *vma )
+{
+	entt_ait_ring_buf_t *buf = file->private_data ;
+	int err ;
+
+	err = remap_vmalloc_range( vma, buf->map, vma->vm_pgoff ) ;
+	if( err ) return err ;
+	vma->vm_private_data = buf ;
+	vma->vm_ops = &entt_ait_ring_vm_ops ;
+	entt_ait_ring_vm_open( vma ) ;
+	return 0 ;
+}
+
+static unsigned int entt_ait_ring_poll( struct file *file, poll_table *wait )
+{
+	entt_ait_ring_buf_t *buf = file->private_data ;
+	struct entt_ait_ring_map *map = buf->map ;
+	unsigned int mask = 0 ;
+
+	poll_wait( file, &buf->wait, wait ) ;
+	if( READ_ONCE(buf->dead) ) return POLLHUP | POLLERR ;
+
+	if( READ_ONCE(map->recv.head) != READ_ONCE(map->recv.tail) ) mask |= POLLIN | POLLRDNORM ;
+	if( READ_ONCE(map->send.tail) - READ_ONCE(map->send.head) < ENTT_RING_SIZE ) mask |= POLLOUT | POLLWRNORM ;
+
+	return mask ;
+}
+
+static const struct file_operations entt_ait_ring_fops = {
+	.owner = THIS_MODULE,
+	.open = entt_ait_ring_open,
+	.release = entt_ait_ring_release,
+	.mmap = entt_ait_ring_mmap,
+	.poll = entt_ait_ring_poll,
+	.llseek = noop_llseek,
+} ;
+
+int entt_ait_ring_create( entt_ait_ring_t *ring, entl_state_machine_t *stm, const char *name )
+{
+	struct entt_ait_ring_map *map ;
+	entt_ait_ring_buf_t *buf ;
+	int err ;
+
+	if( ring->map ) return 0 ;
+
+	spin_lock_init( &ring->lock ) ;
+	ring->stm = stm ;
+	ring->send_pending = 0 ;
+
+	buf = kzalloc( sizeof(entt_ait_ring_buf_t), GFP_KERNEL ) ;
+	if( !buf ) return -ENOMEM ;
+	// vmalloc_user gives zeroed memory which is allowed to be mapped to the user
+	map = vmalloc_user( sizeof(struct entt_ait_ring_map) ) ;
+	if( !map ) {
+		kfree( buf ) ;
+		return -ENOMEM ;
+	}
+	kref_init( &buf->ref ) ;
+	init_waitqueue_head( &buf->wait ) ;
+	buf->map = map ;
+
+	snprintf( ring->misc_name, sizeof(ring->misc_name), ENTT_RING_DEV_PREFIX "%s", name ) ;
+	ring->misc.minor = MISC_DYNAMIC_MINOR ;
+	ring->misc.name = ring->misc_name ;
+	ring->misc.fops = &entt_ait_ring_fops ;
+
+	// nothing is posted yet, so the user has to ring the doorbell for the first message
+	map->send.flags = ENTT_RING_F_NEED_WAKEUP ;
+	ring->buf = buf ;
+	ring->map = map ;
+
+	err = misc_register( &ring->misc ) ;
+	if( err ) {
+		ENTL_DEBUG( "%s entt_ait_ring_create failed to register %s with %d\n", name, ring->misc_name, err ) ;
+		ring->map = NULL ;
+		ring->buf = NULL ;
+		entt_ait_ring_buf_put( buf ) ;
+		return err ;
+	}
+	ENTL_DEBUG( "%s entt_ait_ring_create /dev/%s %ld bytes\n", name, ring->misc_name, sizeof(struct entt_ait_ring_map) ) ;
+	return 0 ;
+}
+
+void entt_ait_ring_destroy( entt_ait_ring_t *ring )
+{
+	entt_ait_ring_buf_t *buf = ring->buf ;
+	unsigned long flags ;
+
+	if( !buf ) return ;
+	// no new opens after this, the files already open keep their reference
+	misc_deregister( &ring->misc ) ;
+
+	spin_lock_irqsave( &ring->lock, flags ) ;
+	ring->map = NULL ;
+	ring->buf = NULL ;
+	ring->stm = NULL ;
+	spin_unlock_irqrestore( &ring->lock, flags ) ;
+
+	WRITE_ONCE( buf->dead, 1 ) ;
+	wake_up_interruptible_all( &buf->wait ) ;
+	entt_ait_ring_buf_put( buf ) ;
+}
+
+void entt_ait_ring_reset( entt_ait_ring_t *ring )
+{
+	unsigned long flags ;
+
+	if( !ring->map ) return ;
+	spin_lock_irqsave( &ring->lock, flags ) ;
+	// entries not acknowledged yet are handed to the new state machine again
+	ring->send_pending = ring->map->send.head ;
+	WRITE_ONCE( ring->map->send.flags, ring->map->send.flags | ENTT_RING_F_NEED_WAKEUP ) ;
+	spin_unlock_irqrestore( &ring->lock, flags ) ;
+}
+
+int entt_ait_ring_refill( entt_ait_ring_t *ring )
+{
+	struct entt_ait_ring_map *map = ring->map ;
+	struct entt_ioctl_ait_data *data ;
+	unsigned long flags ;
+	int count = 0 ;
+
+	if( !map ) return 0 ;
+
+	spin_lock_irqsave( &ring->lock, flags ) ;
+	while( 1 ) {
+		u32 tail = smp_load_acquire( &map->send.tail ) ;
+
+		if( tail == ring->send_pending ) {
+			// drained, ask for a doorbell and re-check so a post racing with the flag is not lost
+			WRITE_ONCE( map->send.flags, map->send.flags | ENTT_RING_F_NEED_WAKEUP ) ;
+			smp_mb() ;
+			if( READ_ONCE(map->send.tail) == ring->send_pending ) break ;
+			WRITE_ONCE( map->send.flags, map->send.flags & ~ENTT_RING_F_NEED_WAKEUP ) ;
+			continue ;
+		}
+		if( tail - READ_ONCE(map->send.head) > ENTT_RING_SIZE ) {
+			ENTL_DEBUG( "%s entt_ait_ring_refill bogus send tail %u head %u\n", ring->stm->name, tail, map->send.head ) ;
+			break ;
+		}
+
+		data = &map->send_ring[ring->send_pending & ENTT_RING_MASK] ;
+		// this is user memory, never trust the length
+		if( data->message_len > MAX_AIT_MESSAGE_SIZE ) data->message_len = MAX_AIT_MESSAGE_SIZE ;
+		// queue full, the next acknowledge refills
+		if( entl_send_AIT_message( ring->stm, data ) < 0 ) break ;
+		ring->send_pending++ ;
+		count++ ;
+	}
+	spin_unlock_irqrestore( &ring->lock, flags ) ;
+
+	return count ;
+}
+
+int entt_ait_ring_owns( entt_ait_ring_t *ring, struct entt_ioctl_ait_data* data )
+{
+	struct entt_ait_ring_map *map = ring->map ;
+
+	if( !map ) return 0 ;
+	return data >= &map->send_ring[0] && data < &map->send_ring[ENTT_RING_SIZE] ;
+}
+
+void entt_ait_ring_complete( entt_ait_ring_t *ring )
+{
+	struct entt_ait_ring_map *map = ring->map ;
+	u32 head = map->send.head ;
+
+	// acknowledged in the order they were handed over, so just move the head
+	smp_store_release( &map->send.head, head + 1 ) ;
+	if( READ_ONCE(map->send.tail) - head == ENTT_RING_SIZE ) {
+		// full -> not full, the user may be sleeping in poll for POLLOUT
+		wake_up_interruptible( &ring->buf->wait ) ;
+	}
+}
+
+int entt_ait_ring_deliver( entt_ait_ring_t *ring )
+{
+	struct entt_ait_ring_map *map = ring->map ;
+	struct entt_ioctl_ait_data *data ;
+	unsigned long flags ;
+	u32 head, tail ;
+	int count = 0 ;
+
+	if( !map ) return 0 ;
+
+	spin_lock_irqsave( &ring->lock, flags ) ;
+	head = smp_load_acquire( &map->recv.head ) ;
+	tail = map->recv.tail ;
+	while( 1 ) {
+		if( tail - head >= ENTT_RING_SIZE ) {
+			// full, the rest waits in the state machine until the user reaps and rings the doorbell.
+			//   Re-check after the flag so a reap racing with it is not lost
+			WRITE_ONCE( map->recv.flags, map->recv.flags | ENTT_RING_F_NEED_WAKEUP ) ;
+			smp_mb() ;
+			head = READ_ONCE( map->recv.head ) ;
+			if( tail - head >= ENTT_RING_SIZE ) break ;
+			WRITE_ONCE( map->recv.flags, map->recv.flags & ~ENTT_RING_F_NEED_WAKEUP ) ;
+			continue ;
+		}
+		data = entl_read_AIT_message( ring->stm ) ;
+		if( !data ) break ;
+		memcpy( &map->recv_ring[tail & ENTT_RING_MASK], data, sizeof(struct entt_ioctl_ait_data) ) ;
+		kfree( data ) ;
+		tail++ ;
+		count++ ;
+		smp_store_release( &map->recv.tail, tail ) ;
+	}
+	spin_unlock_irqrestore( &ring->lock, flags ) ;
+
+	// only an empty -> non-empty transition needs a wakeup, a busy consumer re-checks tail itself
+	smp_mb() ;
+	if( count && READ_ONCE(map->recv.head) == tail - count ) {
+		wake_up_interruptible( &ring->buf->wait ) ;
+	}
+	return count ;
+}
@@ -0,0 +1,64 @@
+/*
+ * ENTT AIT shared-memory rings
+ * Copyright(c) 2016 Earth Computing.
+ *
+ */
+#ifndef _ENTL_AIT_RING_H_
+#define _ENTL_AIT_RING_H_
+
+#include <linux/miscdevice.h>
+#include <linux/wait.h>
+#include <linux/kref.h>
+
+#include "entl_state_machine.h"
+
+#define ENTT_RING_DEV_NAME_LEN (sizeof(ENTT_RING_DEV_PREFIX) + IFNAMSIZ)
+
+/// The shared area and what the open files need of it. The port, each open file and each mapping hold a
+///   reference, so the area outlives the port while the user still has it open or mapped
+typedef struct entt_ait_ring_buf {
+	struct kref ref ;
+	struct entt_ait_ring_map *map ;
+	wait_queue_head_t wait ;              // poll() waiters
+	int dead ;                            // the port destroyed the ring, poll() reports POLLHUP
+} entt_ait_ring_buf_t ;
+
+/// The driver side of the AIT rings of one port
+typedef struct entt_ait_ring {
+	struct entt_ait_ring_map *map ;       // buf->map, NULL until SIOCDEVPRIVATE_ENTT_RING_SETUP
+	entt_ait_ring_buf_t *buf ;            // the port's reference, NULL with map
+	spinlock_t lock ;                     // protects send_pending and the recv ring producer
+	u32 send_pending ;                    // send ring entries handed to the state machine, head <= send_pending <= tail
+	entl_state_machine_t *stm ;
+	struct miscdevice misc ;
+	char misc_name[ENTT_RING_DEV_NAME_LEN] ;
+} entt_ait_ring_t ;
+
+/// allocate the shared area and register /dev/entt_<name>, 0 if OK (or already done)
+int entt_ait_ring_create( entt_ait_ring_t *ring, entl_state_machine_t *stm, const char *name ) ;
+
+/// unregister the device and detach the ring from the port, once the state machine no longer runs.
+///   The shared area is freed with the last open file or mapping of the user
+void entt_ait_ring_destroy( entt_ait_ring_t *ring ) ;
+
+/// forget the entries handed to the state machine (the state machine was re-initialized)
+void entt_ait_ring_reset( entt_ait_ring_t *ring ) ;
+
+/// hand posted send ring entries to the state machine, returns number of entries taken
+int entt_ait_ring_refill( entt_ait_ring_t *ring ) ;
+
+/// true if the AIT data lives in the send ring
+int entt_ait_ring_owns( entt_ait_ring_t *ring, struct entt_ioctl_ait_data* data ) ;
+
+/// the oldest pending send entry was acknowledged, called with the state machine lock held
+void entt_ait_ring_complete( entt_ait_ring_t *ring ) ;
+
+/// move received AIT messages from the state machine to the recv ring, returns number of messages moved
+int entt_ait_ring_deliver( entt_ait_ring_t *ring ) ;
+
+static inline int entt_ait_ring_active( entt_ait_ring_t *ring )
+{
+	return ring->map != NULL ;
+}
+
+#endif
@@ -10,16 +10,89 @@
  // #include "entl_device.h"
 
 static int ENTL_skb_queue_has_data( ENTL_skb_queue_t* q )  ;
-static void init_ENTL_skb_queue( ENTL_skb_queue_t* q ) ;
+static void init_ENTL_skb_queue( ENTL_skb_queue_t* q, int slots ) ;
+static void free_ENTL_skb_queue( ENTL_skb_queue_t* q ) ;
 static struct sk_buff *pop_front_ENTL_skb_queue(ENTL_skb_queue_t* q ) ;
 static int ENTL_skb_queue_unused( ENTL_skb_queue_t* q ) ;
+static struct sk_buff *entl_tx_peek( entl_device_t *dev, int *cls ) ;
+static void entl_tx_pop( entl_device_t *dev, int cls ) ;
+static int entl_tx_queue_room( entl_device_t *dev ) ;
+static void entl_token_ring_reclaim( struct e1000_ring *ring ) ;
+static const entl_link_ops_t entl_e1000_link_ops ;
+
+#ifdef DEFINE_STATIC_KEY_FALSE
+DEFINE_STATIC_KEY_FALSE(entl_port_key);
+#endif
+
+// cycle accounting of the hot paths, turned on and off at run time by /sys/module/e1000e/parameters/entl_cycles
+static bool entl_cycles ;
+
+#ifdef DEFINE_STATIC_KEY_FALSE
+DEFINE_STATIC_KEY_FALSE(entl_cycles_key);
+#define entl_cycles_on() static_branch_unlikely(&entl_cycles_key)
+#else
+#define entl_cycles_on() unlikely(entl_cycles)
+#endif
+
+static int entl_cycles_set( const char *val, const struct kernel_param *kp )
+{
+	int err = param_set_bool( val, kp ) ;
+
+	if( err ) return err ;
+#ifdef DEFINE_STATIC_KEY_FALSE
+	if( entl_cycles ) static_branch_enable( &entl_cycles_key ) ;
+	else static_branch_disable( &entl_cycles_key ) ;
+#endif
+	return 0 ;
+}
+
+static const struct kernel_param_ops entl_cycles_ops = {
+	.set = entl_cycles_set,
+	.get = param_get_bool,
+} ;
+module_param_cb(entl_cycles, &entl_cycles_ops, &entl_cycles, 0644);
+MODULE_PARM_DESC(entl_cycles, "Count the cpu cycles of the ENTL hot paths per port");
+
+// 0 when the accounting is off, so the matching entl_cycles_stop does nothing
+static inline cycles_t entl_cycles_start( void )
+{
+	return entl_cycles_on() ? get_cycles() : 0 ;
+}
+
+static inline void entl_cycles_stop( entl_device_t *dev, int cls, cycles_t start )
+{
+	entl_cycles_stats_t *c = &dev->stats.cycles[cls] ;
+
+	if( !start ) return ;
+	WRITE_ONCE( c->cycles, c->cycles + (u64)(get_cycles() - start) ) ;
+	WRITE_ONCE( c->events, c->events + 1 ) ;
+}
+
+static void entl_port_enable( struct e1000_adapter *adapter )
+{
+	if( adapter->entl_flag ) return ;
+#ifdef DEFINE_STATIC_KEY_FALSE
+	// the key is on before any hook can see the flag
+	static_key_slow_inc( &entl_port_key.key ) ;
+#endif
+	adapter->entl_flag = 1 ;
+}
+
+static void entl_port_disable( struct e1000_adapter *adapter )
+{
+	if( !adapter->entl_flag ) return ;
+	adapter->entl_flag = 0 ;
+#ifdef DEFINE_STATIC_KEY_FALSE
+	static_key_slow_dec( &entl_port_key.key ) ;
+#endif
+}
 
 /// function to inject min-size message for ENTL
 //    it returns 0 if success, 1 if need to retry due to resource, -1 if fatal 
 //
 //    ToDo:  need a mutex for the tx_ring access
 //
-static int inject_message( entl_device_t *dev, __u16 u_addr, __u32 l_addr, int flag )
+static int entl_inject_message( entl_device_t *dev, __u16 u_addr, __u32 l_addr, int flag )
 {
 	struct e1000_adapter *adapter = container_of( dev, struct e1000_adapter, entl_dev );
 	struct net_device *netdev = adapter->netdev;
@@ -28,47 +101,53 @@ static int inject_message( entl_device_t *dev, __u16 u_addr, __u32 l_addr, int f
 	struct e1000_buffer *buffer_info;
 	struct sk_buff *skb;
     struct e1000_ring *tx_ring = adapter->tx_ring ;
-	unsigned char d_addr[ETH_ALEN] ;
+    struct e1000_ring *token_ring = dev->token_ring ;
 	u32 txd_upper = 0, txd_lower = E1000_TXD_CMD_IFCS;
 	struct entt_ioctl_ait_data* ait_data ;
+	u32 ait_len ;
 	int len ;
 
-	if (test_bit(__E1000_DOWN, &adapter->state)) return 1 ;
-	if( e1000_desc_unused(tx_ring) < 3 ) return 1 ; 
-
-	d_addr[0] = (u_addr >> 8) | 0x80 ; // set messege only flag
-	d_addr[1] = u_addr ;
-	d_addr[2] = l_addr >> 24 ;
-	d_addr[3] = l_addr >> 16;
-	d_addr[4] = l_addr >> 8;
-	d_addr[5] = l_addr ;
-
-	if( flag & ENTL_ACTION_SEND_AIT ) {
-		ait_data = entl_next_AIT_message( &dev->stm ) ;
-		len = ETH_HLEN + ait_data->message_len + sizeof(u32) ;
-		if( len < ETH_ZLEN ) len = ETH_ZLEN ; // min length = 60 defined in include/uapi/linux/if_ether.h
-		len += ETH_FCS_LEN ;
-		skb = __netdev_alloc_skb( netdev, len , GFP_ATOMIC );
+	// tokens go on their own hardware queue if there is one, so they don't wait behind the data frames
+	if( token_ring ) {
+		tx_ring = token_ring ;
+		entl_token_ring_reclaim( tx_ring ) ;
 	}
-	else {
-		len = ETH_ZLEN + ETH_FCS_LEN ;
-		skb = __netdev_alloc_skb( netdev, len, GFP_ATOMIC );
+	if (test_bit(__E1000_DOWN, &adapter->state) || e1000_desc_unused(tx_ring) < 3) {
+		ENTL_STAT_INC( dev, inject_busy ) ;
+		return 1 ;
 	}
+
+	len = entl_link_message_len( &dev->link, flag, &ait_data, &ait_len ) + ETH_FCS_LEN ;
+	skb = __netdev_alloc_skb( netdev, len, GFP_ATOMIC );
 	if( skb ) {
 		int i ;
-		struct ethhdr *eth = (struct ethhdr *)skb->data ;
-		unsigned char *cp = skb->data + sizeof(struct ethhdr) ;
+		unsigned char *cp ;
 		skb->len = len ;     // min packet size + crc
-		memcpy(eth->h_source, netdev->dev_addr, ETH_ALEN);
-		memcpy(eth->h_dest, d_addr, ETH_ALEN);
-		eth->h_proto = 0 ; // protocol type is not used anyway
+		cp = entl_link_message_fill( skb->data, len, netdev->dev_addr, u_addr, l_addr, ait_data, ait_len ) ;
 		if( flag & ENTL_ACTION_SEND_AIT ) {
-			memcpy( cp, &ait_data->message_len, sizeof(u32)) ;
-			memcpy( cp + sizeof(u32), ait_data->data, ait_data->message_len) ;
 			ENTL_DEBUG("inject_message %02x %02x %02x %02x %02x %02x %02x %02x \n", cp[0], cp[1],cp[2],cp[3],cp[4],cp[5],cp[6],cp[7] );
 
 		}
-		i = adapter->tx_ring->next_to_use;
+		else if( dev->alo_reply_pending && (u_addr & ENTL_MESSAGE_MASK) == ENTL_MESSAGE_ACK_U ) {
+			// the Ack of an ALO operation carries its result
+			memcpy( cp, &dev->alo_reply, sizeof(entl_alo_result_t)) ;
+			dev->alo_reply_pending = 0 ;
+		}
+#ifdef HAVE_HW_TIME_STAMP
+		else if( dev->hwts_on ) {
+			// tell the peer how long we took to answer, so it can take it out of its round trip
+			u32 magic = ENTL_HWTS_MAGIC ;
+			memcpy( cp, &magic, sizeof(u32)) ;
+			memcpy( cp + sizeof(u32), &dev->hwts_turnaround_ns, sizeof(u32)) ;
+		}
+		// one tx timestamp at a time, and not while the stack waits for one
+		if( dev->hwts_on && !dev->hwts_tx_pending && !adapter->tx_hwtstamp_skb && (u_addr & ENTL_MESSAGE_MASK) != ENTL_MESSAGE_HELLO_U ) {
+			txd_lower |= E1000_TXD_CMD_DEXT | E1000_TXD_DTYP_D;
+			txd_upper |= E1000_TXD_EXTCMD_TSTAMP;
+			dev->hwts_tx_pending = 1 ;
+		}
+#endif
+		i = tx_ring->next_to_use;
 		buffer_info = &tx_ring->buffer_info[i];
 		buffer_info->length = skb->len;
 		buffer_info->time_stamp = jiffies;
@@ -80,13 +159,14 @@ static int inject_message( entl_device_t *dev, __u16 u_addr, __u32 l_addr, int f
 		if (dma_mapping_error(&pdev->dev, buffer_info->dma))
 		{
 			ENTL_DEBUG("ENTL inject_message failed map dma\n");
+			ENTL_STAT_INC( dev, inject_dma_err ) ;
 			buffer_info->dma = 0;
 			dev_kfree_skb_any(skb);
 			return -1 ;
 		}
 		buffer_info->skb = skb ;
-		// report number of byte queued for sending to the device hardware queue
-		netdev_sent_queue(netdev, skb->len);
+		// report number of byte queued for sending to the device hardware queue, the token ring is not part of it
+		if( !token_ring ) netdev_sent_queue(netdev, skb->len);
 		// process e1000_tx_queue
 		tx_desc = E1000_TX_DESC(*tx_ring, i);
 		tx_desc->buffer_addr = cpu_to_le64(buffer_info->dma);
@@ -106,526 +186,1048 @@ static int inject_message( entl_device_t *dev, __u16 u_addr, __u32 l_addr, int f
 
 		tx_ring->next_to_use = i;
 
-		// Update TDT register in the NIC
-		if (adapter->flags2 & FLAG2_PCIM2PCI_ARBITER_WA)
-			e1000e_update_tdt_wa(tx_ring,
-						     tx_ring->next_to_use);
-		else
-			writel(tx_ring->next_to_use, tx_ring->tail);
-
-		/* we need this if more than one processor can write
-		 * to our tail at a time, it synchronizes IO on
-		 *IA64/Altix systems
-		 */
-		mmiowb();
+		// Update TDT register in the NIC, unless the NAPI batch does it at the end.
+		// The token ring has nothing to batch with, it goes at once
+		if( token_ring || !e1000_tx_tail_deferred( adapter ) ) {
+			if (adapter->flags2 & FLAG2_PCIM2PCI_ARBITER_WA)
+				e1000e_update_tdt_wa(tx_ring,
+							     tx_ring->next_to_use);
+			else
+				writel(tx_ring->next_to_use, tx_ring->tail);
+
+			/* we need this if more than one processor can write
+			 * to our tail at a time, it synchronizes IO on
+			 *IA64/Altix systems
+			 */
+			mmiowb();
+		}
 		//ENTL_DEBUG("ENTL inject_message %04x %08x injected on %d\n", u_addr, l_addr, i);
-
+		ENTL_STAT_INC( dev, tokens_sent ) ;
+		if( flag & ENTL_ACTION_SEND_AIT ) ENTL_STAT_INC( dev, ait_sent ) ;
 	}
 	else {
 		ENTL_DEBUG("ENTL inject_message failed to allocate sk_buffer\n");
+		ENTL_STAT_INC( dev, inject_nomem ) ;
 		return -1 ;
 	}
 	return 0 ;
 }
 
-/**
- * entl_watchdog - Timer Call-back
- * @data: pointer to adapter cast into an unsigned long
- **/
-static void entl_watchdog(unsigned long data)
+// room for a message on the ring inject_message puts it on, with the token ring reclaimed first
+//   as nothing else cleans it. Called with tx_ring_lock held
+static bool entl_inject_room( entl_device_t *dev )
 {
-	entl_device_t *dev = (entl_device_t *)data;
+	struct e1000_adapter *adapter = container_of( dev, struct e1000_adapter, entl_dev );
 
-	/* Do the rest outside of interrupt context */
-	schedule_work(&dev->watchdog_task);           // schedule task using the global kernel work queue
+	if( dev->token_ring ) {
+		entl_token_ring_reclaim( dev->token_ring ) ;
+		return e1000_desc_unused( dev->token_ring ) >= 3 ;
+	}
+	return e1000_desc_unused( adapter->tx_ring ) >= 3 ;
+}
+
+// entl_link_ops_t inject, the messages go on the tx rings under tx_ring_lock
+static int entl_e1000_inject( entl_link_t *link, __u16 u_addr, __u32 l_addr, int flag )
+{
+	entl_device_t *dev = container_of( link, entl_device_t, link ) ;
+	struct e1000_adapter *adapter = container_of( dev, struct e1000_adapter, entl_dev );
+	cycles_t start = entl_cycles_start() ;
+	unsigned long flags ;
+	int ret ;
+
+	spin_lock_irqsave( &adapter->tx_ring_lock, flags ) ;
+	ret = entl_inject_message( dev, u_addr, l_addr, flag ) ;
+	spin_unlock_irqrestore( &adapter->tx_ring_lock, flags ) ;
+	entl_cycles_stop( dev, ENTL_CYCLES_INJECT, start ) ;
+	return ret ;
+}
 
+// entl_link_ops_t tx_ready, for the Hello and the retry of the watchdog task
+static int entl_e1000_tx_ready( entl_link_t *link )
+{
+	entl_device_t *dev = container_of( link, entl_device_t, link ) ;
+	struct e1000_adapter *adapter = container_of( dev, struct e1000_adapter, entl_dev );
+	unsigned long flags ;
+	bool room ;
+
+	if (test_bit(__E1000_DOWN, &adapter->state)) return -ENETDOWN ;
+	spin_lock_irqsave( &adapter->tx_ring_lock, flags ) ;
+	room = entl_inject_room( dev ) ;
+	spin_unlock_irqrestore( &adapter->tx_ring_lock, flags ) ;
+	return room ? 0 : -EBUSY ;
 }
 
+// the link watchdog, on the task of the link, with its cycles counted
 static void entl_watchdog_task(struct work_struct *work)
 {
-	unsigned long wakeup = 1 * HZ ;  // one second
-		      
-	// ENTL_DEBUG("entl_watchdog_task wakes up\n");
+	entl_link_t *link = container_of( work, entl_link_t, watchdog_task ) ;
+	entl_device_t *dev = container_of( link, entl_device_t, link ) ;
+	cycles_t start = entl_cycles_start() ;
 
-	entl_device_t *dev = container_of(work, entl_device_t, watchdog_task); // get the struct pointer from a member
-	struct e1000_adapter *adapter = container_of( dev, struct e1000_adapter, entl_dev );
+	entl_link_watchdog( link ) ;
+	entl_cycles_stop( dev, ENTL_CYCLES_WATCHDOG, start ) ;
+}
+
+static void entl_itr_token_received( entl_device_t *dev )
+{
+	ktime_t now = ktime_get() ;
+	s64 ns = ktime_to_ns( ktime_sub( now, dev->last_token_time ) ) ;
+
+	dev->last_token_time = now ;
+	dev->itr_tokens++ ;
+	if( ns <= 0 || ns > NSEC_PER_SEC ) return ;  // link was idle or just came up
+	// the time between two received tokens is one round trip of the exchange
+	dev->rtt_hist[clamp_t( int, ilog2( (u32)ns ) - ENTL_RTT_HIST_SHIFT, 0, ENTL_RTT_HIST_BUCKETS - 1 )]++ ;
+	// moving average with 1/8 weight
+	dev->token_interval_ns = dev->token_interval_ns - (dev->token_interval_ns >> 3) + ((u32)ns >> 3) ;
+}
 
-	if( !dev->flag ) {
-		dev->flag |= ENTL_DEVICE_FLAG_WAITING ;
-		goto restart_watchdog ;
+static void entl_set_itr( struct e1000_adapter *adapter )
+{
+	entl_device_t *dev = &adapter->entl_dev ;
+	struct e1000_hw *hw = &adapter->hw;
+	u32 data = dev->itr_data_frames + entl_tx_queue_has_data( dev ) ;
+	u32 target = 0 ;
+	u32 radv, itr ;
+
+	// data dominates when there is more of it than one token can carry
+	if( data > dev->itr_tokens * max_t(u32, dev->burst_frames, ENTL_ITR_DATA_PER_TOKEN) ) {
+		// coalesce, but never add more than a quarter of the token interval
+		target = min_t( u32, dev->token_interval_ns / 4, ENTL_ITR_MAX_DELAY_NS ) ;
 	}
-	if( (dev->flag & ENTL_DEVICE_FLAG_SIGNAL) && dev->user_pid ) {
-		struct siginfo info;
-		struct task_struct *t;
-		info.si_signo=SIGIO;
-		info.si_int=1;
-		info.si_code = SI_QUEUE;        
-		dev->flag &= ~(__u32)ENTL_DEVICE_FLAG_SIGNAL ;
-		t= pid_task(find_vpid(dev->user_pid),PIDTYPE_PID);//user_pid has been fetched successfully
-		if(t == NULL){
-		        ENTL_DEBUG("ENTL %s no such pid, cannot send signal\n", dev->name);
-		} else {
-		        ENTL_DEBUG("ENTL %s found the task, sending SIGUSR1 signal\n", dev->name);
-		        send_sig_info(SIGUSR1, &info, t);
-		}
+	dev->itr_tokens = 0 ;
+	dev->itr_data_frames = 0 ;
+
+	// go to the low latency setting at once, and to the coalescing one in steps
+	if( target > dev->itr_delay_ns ) target = dev->itr_delay_ns + (target - dev->itr_delay_ns + 3) / 4 ;
+	dev->itr_delay_ns = target ;
+
+	// RDTR/RADV are in 1.024 usec units, only touch the registers when they change
+	radv = target / 1024 ;
+	if( radv == dev->itr_radv ) return ;
+	dev->itr_radv = radv ;
+
+	ew32(RDTR, radv / 4);
+	ew32(RADV, radv);
+	itr = radv ? NSEC_PER_SEC / (radv * 1024) : 0 ;
+	adapter->itr = itr;
+	adapter->rx_ring->itr_val = itr;
+	if (adapter->msix_entries)
+		adapter->rx_ring->set_itr = 1;
+	else
+		e1000e_write_itr(adapter, itr);
+	ENTL_DEBUG("ENTL %s entl_set_itr token interval %u ns RADV %u ITR %u\n", adapter->netdev->name, dev->token_interval_ns, radv, itr );
+}
+
+#ifdef HAVE_HW_TIME_STAMP
+static u64 entl_hwts_to_ns( struct e1000_adapter *adapter, u64 systim )
+{
+	struct skb_shared_hwtstamps ts ;
+
+	e1000e_systim_to_hwtstamp( adapter, &ts, systim ) ;
+	return ktime_to_ns( ts.hwtstamp ) ;
+}
+
+static void entl_hwts_start( struct e1000_adapter *adapter )
+{
+	entl_device_t *dev = &adapter->entl_dev ;
+
+	dev->hwts_on = 0 ;
+	dev->hwts_tx_pending = 0 ;
+	dev->hwts_rx_ns = 0 ;
+	dev->hwts_last_rx_ns = 0 ;
+	dev->hwts_turnaround_ns = 0 ;
+	dev->hw_rtt_ns = 0 ;
+	dev->hw_one_way_ns = 0 ;
+
+	if( !dev->hwts ) return ;
+	if( !(adapter->flags & FLAG_HAS_HW_TIMESTAMP) ) {
+		ENTL_DEBUG("ENTL %s no hardware timestamps on this MAC\n", adapter->netdev->name );
+		return ;
 	}
-	else if( (dev->flag & ENTL_DEVICE_FLAG_SIGNAL2) && dev->user_pid ) {
-		struct siginfo info;
-		struct task_struct *t;
-		info.si_signo=SIGIO;
-		info.si_int=1;
-		info.si_code = SI_QUEUE;        
-		dev->flag &= ~(__u32)ENTL_DEVICE_FLAG_SIGNAL2 ;
-		t= pid_task(find_vpid(dev->user_pid),PIDTYPE_PID);//user_pid has been fetched successfully
-		if(t == NULL){
-		        ENTL_DEBUG("ENTL %s no such pid, cannot send signal\n", dev->name);
-		} else {
-		        ENTL_DEBUG("ENTL %s found the task, sending SIGUSR2 signal\n", dev->name);
-		        send_sig_info(SIGUSR2, &info, t);
-		}
+	// tokens are not PTP frames, so every frame has to be timestamped.
+	// The config is kept in the adapter so e1000e_reset sets it again.
+	adapter->hwtstamp_config.tx_type = HWTSTAMP_TX_ON ;
+	adapter->hwtstamp_config.rx_filter = HWTSTAMP_FILTER_ALL ;
+	if( e1000e_config_hwtstamp( adapter, &adapter->hwtstamp_config ) ) {
+		ENTL_DEBUG("ENTL %s failed to set up hardware timestamps\n", adapter->netdev->name );
+		return ;
+	}
+	dev->hwts_on = 1 ;
+}
+
+static void entl_hwts_rx( struct e1000_adapter *adapter, u32 staterr )
+{
+	entl_device_t *dev = &adapter->entl_dev ;
+	struct e1000_hw *hw = &adapter->hw;
+	u64 rxstmp ;
+
+	// only one frame is timestamped until the registers are read, same as e1000e_rx_hwtstamp
+	if( !(staterr & E1000_RXDEXT_STATERR_TST) || !(er32(TSYNCRXCTL) & E1000_TSYNCRXCTL_VALID) ) {
+		dev->hwts_rx_ns = 0 ;
+		return ;
+	}
+	rxstmp = (u64)er32(RXSTMPL);
+	rxstmp |= (u64)er32(RXSTMPH) << 32;
+	dev->hwts_rx_ns = entl_hwts_to_ns( adapter, rxstmp ) ;
+	adapter->flags2 &= ~FLAG2_CHECK_RX_HWTSTAMP;
+}
+
+static void entl_hwts_token_received( entl_device_t *dev, const u8 *data, unsigned int len )
+{
+	struct e1000_adapter *adapter = container_of( dev, struct e1000_adapter, entl_dev );
+	struct e1000_hw *hw = &adapter->hw;
+	u64 rx_ns = dev->hwts_rx_ns ;
+	u64 txstmp = 0 ;
+	bool valid = false ;
+	unsigned long flags ;
+
+	dev->hwts_rx_ns = 0 ;
+	if( !rx_ns ) return ;
+
+	// the reply to our last token is here, so that token is long gone on the wire.
+	//   The timestamp request is set on the tx side under tx_ring_lock, so check and clear it there
+	spin_lock_irqsave( &adapter->tx_ring_lock, flags ) ;
+	if( dev->hwts_tx_pending && (er32(TSYNCTXCTL) & E1000_TSYNCTXCTL_VALID) ) {
+		txstmp = (u64)er32(TXSTMPL);
+		txstmp |= (u64)er32(TXSTMPH) << 32;
+		valid = true ;
 	}
-	if( netif_carrier_ok(adapter->netdev) && dev->flag & ENTL_DEVICE_FLAG_HELLO ) {
-		int t ;
-    	struct e1000_ring *tx_ring = adapter->tx_ring ;
-		//entl_state_t st ;
-		ENTL_DEBUG("ENTL %s entl_watchdog_task trying to send hello\n", dev->name );
-		//entl_read_current_state( &dev->stm, &st ) ;
-		if (test_bit(__E1000_DOWN, &adapter->state)) {
-			ENTL_DEBUG("ENTL %s entl_watchdog_task got __E1000_DOWN\n", dev->name );
-			goto restart_watchdog ;
+	// not valid means the timestamp was lost, ask again on the next token
+	dev->hwts_tx_pending = 0 ;
+	spin_unlock_irqrestore( &adapter->tx_ring_lock, flags ) ;
+
+	if( valid ) {
+		u64 tx_ns = entl_hwts_to_ns( adapter, txstmp ) ;
+		if( dev->hwts_last_rx_ns && tx_ns > dev->hwts_last_rx_ns ) dev->hwts_turnaround_ns = tx_ns - dev->hwts_last_rx_ns ;
+		if( rx_ns > tx_ns ) {
+			u32 magic, turnaround ;
+			dev->hw_rtt_ns = rx_ns - tx_ns ;
+			// the peer turnaround is the one of its previous exchange, close enough on a steady link
+			if( len >= ETH_HLEN + 2 * sizeof(u32) ) {
+				memcpy( &magic, data + ETH_HLEN, sizeof(u32) ) ;
+				memcpy( &turnaround, data + ETH_HLEN + sizeof(u32), sizeof(u32) ) ;
+				if( magic == ENTL_HWTS_MAGIC && turnaround < dev->hw_rtt_ns ) dev->hw_one_way_ns = (dev->hw_rtt_ns - turnaround) / 2 ;
+			}
 		}
-		if( (t = e1000_desc_unused(tx_ring) ) < 3 ) {
-			ENTL_DEBUG("ENTL %s entl_watchdog_task got t = %d\n", dev->name, t );
-			goto restart_watchdog ; 
+	}
+	dev->hwts_last_rx_ns = rx_ns ;
+}
+#else
+static void entl_hwts_start( struct e1000_adapter *adapter ) { adapter->entl_dev.hwts_on = 0 ; }
+static void entl_hwts_rx( struct e1000_adapter *adapter, u32 staterr ) {}
+static void entl_hwts_token_received( entl_device_t *dev, const u8 *data, unsigned int len ) {}
+#endif
+
+static void entl_lowlat_apply( struct e1000_adapter *adapter )
+{
+	entl_device_t *dev = &adapter->entl_dev ;
+	struct e1000_hw *hw = &adapter->hw;
+	struct pci_dev *pdev = adapter->pdev ;
+	struct pci_dev *parent = pdev->bus->self ;
+
+	if( !dev->lowlat || dev->lowlat_applied ) return ;
+	dev->lowlat_applied = 1 ;
+
+	// keep the cpus out of the deep C-states
+#if defined(HAVE_PM_QOS_REQUEST_LIST_NEW) || defined(HAVE_PM_QOS_REQUEST_LIST)
+	pm_qos_add_request( &dev->lowlat_qos, PM_QOS_CPU_DMA_LATENCY, ENTL_LOWLAT_CPU_LATENCY_USEC ) ;
+#endif
+
+	// EEE is set up with the link, which comes after this
+	if( (adapter->flags2 & FLAG2_HAS_EEE) && !hw->dev_spec.ich8lan.eee_disable ) {
+		hw->dev_spec.ich8lan.eee_disable = true ;
+		dev->lowlat_eee_changed = 1 ;
+	}
+
+	// remember ASPM on both ends of the link before turning it off
+	pcie_capability_read_word( pdev, PCI_EXP_LNKCTL, &dev->lowlat_aspm ) ;
+	dev->lowlat_aspm &= PCI_EXP_LNKCTL_ASPMC ;
+	dev->lowlat_parent_aspm = 0 ;
+	if( parent ) {
+		pcie_capability_read_word( parent, PCI_EXP_LNKCTL, &dev->lowlat_parent_aspm ) ;
+		dev->lowlat_parent_aspm &= PCI_EXP_LNKCTL_ASPMC ;
+	}
+	e1000e_disable_aspm( pdev, PCIE_LINK_STATE_L0S | PCIE_LINK_STATE_L1 ) ;
+
+	ENTL_DEBUG("ENTL %s low-latency profile applied, eee %d aspm %x parent aspm %x\n", adapter->netdev->name, dev->lowlat_eee_changed, dev->lowlat_aspm, dev->lowlat_parent_aspm );
+}
+
+static void entl_lowlat_restore( struct e1000_adapter *adapter )
+{
+	entl_device_t *dev = &adapter->entl_dev ;
+	struct e1000_hw *hw = &adapter->hw;
+	struct pci_dev *pdev = adapter->pdev ;
+	struct pci_dev *parent = pdev->bus->self ;
+
+	if( !dev->lowlat_applied ) return ;
+	dev->lowlat_applied = 0 ;
+
+#if defined(HAVE_PM_QOS_REQUEST_LIST_NEW) || defined(HAVE_PM_QOS_REQUEST_LIST)
+	pm_qos_remove_request( &dev->lowlat_qos ) ;
+#endif
+
+	// takes effect on the next link setup
+	if( dev->lowlat_eee_changed ) {
+		hw->dev_spec.ich8lan.eee_disable = false ;
+		dev->lowlat_eee_changed = 0 ;
+	}
+
+	// enable upstream first
+	if( parent && dev->lowlat_parent_aspm ) pcie_capability_set_word( parent, PCI_EXP_LNKCTL, dev->lowlat_parent_aspm ) ;
+	if( dev->lowlat_aspm ) pcie_capability_set_word( pdev, PCI_EXP_LNKCTL, dev->lowlat_aspm ) ;
+
+	ENTL_DEBUG("ENTL %s low-latency profile restored\n", adapter->netdev->name );
+}
+
+static void entl_lowlat_set_irq_affinity( struct e1000_adapter *adapter, const struct cpumask *mask )
+{
+	if (adapter->msix_entries) {
+		int vector ;
+		for (vector = 0; vector < adapter->num_vectors; vector++)
+			irq_set_affinity_hint( adapter->msix_entries[vector].vector, mask ) ;
+	}
+	else {
+		irq_set_affinity_hint( adapter->pdev->irq, mask ) ;
+	}
+}
+
+static void entl_lowlat_pin_irq( struct e1000_adapter *adapter )
+{
+	entl_device_t *dev = &adapter->entl_dev ;
+	int node = dev_to_node( &adapter->pdev->dev ) ;
+	int cpu ;
+
+	if( dev->lowlat_irq_pinned ) return ;
+
+	// on the token core of the port, else next to the busy poll thread if there is one, otherwise on the node of the device
+	if( dev->placement.token_cpu >= 0 ) cpu = dev->placement.token_cpu ;
+	else if( !dev->lowlat ) return ;
+	else if( dev->busy_poll_cpu >= 0 && cpu_online( dev->busy_poll_cpu ) ) cpu = dev->busy_poll_cpu ;
+	else if( node == NUMA_NO_NODE ) cpu = cpumask_first( cpu_online_mask ) ;
+	else cpu = cpumask_first( cpumask_of_node( node ) ) ;
+
+	entl_lowlat_set_irq_affinity( adapter, cpumask_of( cpu ) ) ;
+	dev->lowlat_irq_pinned = 1 ;
+	ENTL_DEBUG("ENTL %s irq pinned on cpu %d\n", adapter->netdev->name, cpu );
+}
+
+static void entl_lowlat_unpin_irq( struct e1000_adapter *adapter )
+{
+	entl_device_t *dev = &adapter->entl_dev ;
+
+	if( !dev->lowlat_irq_pinned ) return ;
+	entl_lowlat_set_irq_affinity( adapter, NULL ) ;
+	dev->lowlat_irq_pinned = 0 ;
+}
+
+#ifdef CONFIG_E1000E_NAPI
+/// one round of the busy poll, called with the NAPI context owned and BH disabled
+static int entl_busy_poll_once( struct e1000_adapter *adapter )
+{
+	entl_device_t *dev = &adapter->entl_dev ;
+	int work_done = 0 ;
+
+	e1000_clean_tx_irq( adapter->tx_ring ) ;
+	entl_tx_batch_begin( dev ) ;
+	adapter->clean_rx( adapter->rx_ring, &work_done, ENTL_BUSY_POLL_BUDGET ) ;
+	entl_tx_batch_end( dev ) ;
+	if( work_done ) napi_gro_flush( &adapter->napi, false ) ;
+	return work_done ;
+}
+
+static int entl_busy_poll_thread( void *data )
+{
+	struct e1000_adapter *adapter = data ;
+	entl_device_t *dev = &adapter->entl_dev ;
+	struct e1000_hw *hw = &adapter->hw;
+
+	while( !kthread_should_stop() ) {
+		ktime_t last ;
+		int tries ;
+
+		set_current_state( TASK_INTERRUPTIBLE ) ;
+		if( !READ_ONCE(dev->busy_poll_kick) ) {
+			schedule() ;
+			continue ;
 		}
-		if( dev->stm.current_state.current_state == ENTL_STATE_HELLO || dev->stm.current_state.current_state == ENTL_STATE_WAIT || dev->stm.current_state.current_state == ENTL_STATE_RECEIVE || dev->stm.current_state.current_state == ENTL_STATE_AM || dev->stm.current_state.current_state == ENTL_STATE_BH) {
-			__u16 u_addr ;
-			__u32 l_addr ;
-			int ret ;
-			if( ret = entl_get_hello(&dev->stm, &u_addr, &l_addr) ){
-				unsigned long flags;
-				int result ;
-				// attomically check to make sure we still need to send hello
-				spin_lock_irqsave( &adapter->tx_ring_lock, flags ) ;
-	    		result = inject_message( dev, u_addr, l_addr, ret ) ;
-	    		spin_unlock_irqrestore( &adapter->tx_ring_lock, flags ) ;
-	    		if( result == 0 ) {
-	    			dev->flag &= ~(__u32)ENTL_DEVICE_FLAG_HELLO ;
-					ENTL_DEBUG("ENTL %s entl_watchdog_task %04x %08x packet sent\n", dev->name, u_addr, l_addr );
-	    		}
-	    		else {
-					ENTL_DEBUG("ENTL %s entl_watchdog_task hello packet failed with %d \n", dev->name, result );	    			
-	    		}
- 			}
- 			else {
- 				ENTL_DEBUG("ENTL %s entl_watchdog_task hello state lost\n", dev->name );
- 			}
+		__set_current_state( TASK_RUNNING ) ;
+		dev->busy_poll_kick = 0 ;
+
+		// take the NAPI context over from the interrupt path, it may still be running the poll which kicked us
+		local_bh_disable() ;
+		for( tries = 0 ; !napi_schedule_prep( &adapter->napi ) ; tries++ ) {
+			local_bh_enable() ;
+			if( tries >= ENTL_BUSY_POLL_CLAIM_TRIES || kthread_should_stop() ) goto sleep_again ;
+			cpu_relax() ;
+			local_bh_disable() ;
 		}
-		else {
-			dev->flag &= ~(__u32)ENTL_DEVICE_FLAG_HELLO ;
-			if(  dev->stm.current_state.current_state != ENTL_STATE_IDLE ){
-				ENTL_DEBUG("ENTL %s entl_watchdog_task not hello/wait state but %d\n", dev->name, dev->stm.current_state.current_state );
-			}
+
+		// no rx/tx interrupts while spinning, e1000e_poll enables them again when we hand back.
+		//   LSC stays on so the watchdog still hears of a link change
+		if (adapter->msix_entries)
+			ew32(IMC, adapter->rx_ring->ims_val);
+		else
+			ew32(IMC, IMS_ENABLE_MASK & ~E1000_IMS_LSC);
+		dev->busy_polls++ ;
+
+		last = ktime_get() ;
+		while( !kthread_should_stop() ) {
+			int work = entl_busy_poll_once( adapter ) ;
+			ktime_t now ;
+
+			local_bh_enable() ;
+			now = ktime_get() ;
+			if( work ) last = now ;
+			cond_resched() ;
+			local_bh_disable() ;
+			if( !work && ktime_us_delta( now, last ) > ENTL_BUSY_POLL_IDLE_USEC ) break ;
+			cpu_relax() ;
 		}
+
+		// hand back to NAPI, the same way the core busy poll does
+		if( e1000e_poll( &adapter->napi, ENTL_BUSY_POLL_BUDGET ) >= ENTL_BUSY_POLL_BUDGET )
+			__napi_schedule( &adapter->napi ) ;
+		local_bh_enable() ;
+	sleep_again:
+		;
+	}
+	return 0 ;
+}
+
+static void entl_busy_poll_start( struct e1000_adapter *adapter )
+{
+	entl_device_t *dev = &adapter->entl_dev ;
+	struct task_struct *task ;
+
+	if( dev->busy_poll_cpu < 0 || dev->busy_poll_task ) return ;
+	if( !cpu_online( dev->busy_poll_cpu ) ) {
+		ENTL_DEBUG("ENTL %s busy poll cpu %d is not online\n", adapter->netdev->name, dev->busy_poll_cpu );
+		return ;
 	}
-	else if(  dev->flag & ENTL_DEVICE_FLAG_RETRY ) {
-		unsigned long flags;
-		int result ;
-		struct e1000_adapter *adapter = container_of( dev, struct e1000_adapter, entl_dev );
-    	struct e1000_ring *tx_ring = adapter->tx_ring ;		
-		ENTL_DEBUG("ENTL %s entl_watchdog_task sending retry\n", dev->name );
-		if (test_bit(__E1000_DOWN, &adapter->state)) goto restart_watchdog ;
-		if( e1000_desc_unused(tx_ring) < 3 ) goto restart_watchdog ; 
-		spin_lock_irqsave( &adapter->tx_ring_lock, flags ) ;
-	    result = inject_message( dev, dev->u_addr, dev->l_addr, dev->action ) ;
-	    spin_unlock_irqrestore( &adapter->tx_ring_lock, flags ) ;
-	    if( result == 0 ) {
-    		dev->flag &= ~(__u32)ENTL_DEVICE_FLAG_RETRY ;
-			dev->flag &= ~(__u32)ENTL_DEVICE_FLAG_WAITING ;
-			ENTL_DEBUG("ENTL %s entl_watchdog_task retry packet sent\n", dev->name );
-	    }
-	    else {
-			ENTL_DEBUG("ENTL %s entl_watchdog_task retry packet failed with %d \n", dev->name, result );	    			
-	    }
+	task = kthread_create( entl_busy_poll_thread, adapter, "entl_poll/%s", adapter->netdev->name ) ;
+	if( IS_ERR(task) ) {
+		ENTL_DEBUG("ENTL %s failed to create busy poll thread %ld\n", adapter->netdev->name, PTR_ERR(task) );
+		return ;
 	}
-	else if( dev->flag & ENTL_DEVICE_FLAG_WAITING )
-	{
-		dev->flag &= ~(__u32)ENTL_DEVICE_FLAG_WAITING ;
-		if( dev->stm.current_state.current_state == ENTL_STATE_HELLO || dev->stm.current_state.current_state == ENTL_STATE_WAIT || dev->stm.current_state.current_state == ENTL_STATE_RECEIVE || dev->stm.current_state.current_state == ENTL_STATE_AM || dev->stm.current_state.current_state == ENTL_STATE_BH ) {
-			dev->flag |= ENTL_DEVICE_FLAG_HELLO ;
-			ENTL_DEBUG("ENTL %s entl_watchdog_task retry message sending\n", dev->name );
+	kthread_bind( task, dev->busy_poll_cpu ) ;
+	dev->busy_poll_task = task ;
+	wake_up_process( task ) ;
+	ENTL_DEBUG("ENTL %s busy poll thread started on cpu %d\n", adapter->netdev->name, dev->busy_poll_cpu );
+}
+
+static void entl_busy_poll_stop( entl_device_t *dev )
+{
+	if( !dev->busy_poll_task ) return ;
+	kthread_stop( dev->busy_poll_task ) ;
+	dev->busy_poll_task = NULL ;
+}
+
+static void entl_busy_poll_kick( entl_device_t *dev )
+{
+	if( !dev->busy_poll_task || dev->busy_poll_kick ) return ;
+	dev->busy_poll_kick = 1 ;
+	wake_up_process( dev->busy_poll_task ) ;
+}
+#else
+static void entl_busy_poll_start( struct e1000_adapter *adapter ) {}
+static void entl_busy_poll_stop( entl_device_t *dev ) {}
+static void entl_busy_poll_kick( entl_device_t *dev ) {}
+#endif /* CONFIG_E1000E_NAPI */
+
+#ifdef CONFIG_RPS
+// RPS of the upward data frames on the data cpus of the port, an empty mask turns it off.
+//   Does what a write to queues/rx-0/rps_cpus does, the port owns the map while it is placed
+static void entl_placement_set_rps( struct e1000_adapter *adapter, const struct cpumask *mask )
+{
+	struct netdev_rx_queue *queue = adapter->netdev->_rx ;
+	struct rps_map *map = NULL, *old ;
+	int cpu, i = 0 ;
+
+	if( !cpumask_empty( mask ) ) {
+		map = kzalloc( max_t(unsigned int, RPS_MAP_SIZE(cpumask_weight( mask )), L1_CACHE_BYTES), GFP_KERNEL ) ;
+		if( !map ) return ;
+		for_each_cpu_and( cpu, mask, cpu_online_mask ) map->cpus[i++] = cpu ;
+		map->len = i ;
+		if( !i ) {
+			kfree( map ) ;
+			map = NULL ;
 		}
 	}
-	restart_watchdog:
-	mod_timer(&dev->watchdog_timer, round_jiffies(jiffies + wakeup));
+
+	old = rtnl_dereference( queue->rps_map ) ;
+	rcu_assign_pointer( queue->rps_map, map ) ;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,1,0)
+	if( map && !old ) static_branch_inc( &rps_needed ) ;
+	if( old && !map ) static_branch_dec( &rps_needed ) ;
+#else
+	if( map && !old ) static_key_slow_inc( &rps_needed ) ;
+	if( old && !map ) static_key_slow_dec( &rps_needed ) ;
+#endif
+	if( old ) kfree_rcu( old, rcu ) ;
 }
+#else
+static void entl_placement_set_rps( struct e1000_adapter *adapter, const struct cpumask *mask ) {}
+#endif /* CONFIG_RPS */
 
-static void entl_device_init( entl_device_t *dev ) 
+// the layout moved the port: interrupts, busy poll thread and watchdog work to the token core, RPS to the data cpus
+static void entl_placement_apply( entl_placement_t *pl )
 {
-	
-	memset(dev, 0, sizeof(struct entl_device));
+	entl_device_t *dev = container_of( pl, entl_device_t, placement ) ;
+	struct e1000_adapter *adapter = container_of( dev, struct e1000_adapter, entl_dev );
+	int cpu = pl->token_cpu ;
+
+	rtnl_lock() ;
+	WRITE_ONCE( dev->link.work_cpu, cpu ) ;
+	if( cpu >= 0 ) {
+		if( dev->lowlat_irq_pinned ) entl_lowlat_set_irq_affinity( adapter, cpumask_of( cpu ) ) ;
+		if( dev->busy_poll_cpu >= 0 ) {
+			dev->busy_poll_cpu = cpu ;
+			if( dev->busy_poll_task ) set_cpus_allowed_ptr( dev->busy_poll_task, cpumask_of( cpu ) ) ;
+		}
+	}
+	entl_placement_set_rps( adapter, &pl->data_cpus ) ;
+	rtnl_unlock() ;
+	ENTL_DEBUG("ENTL %s placed, token cpu %d data cpus %*pbl\n", adapter->netdev->name, cpu, cpumask_pr_args( &pl->data_cpus ) );
+}
 
-	// watchdog timer & task setup
-	init_timer(&dev->watchdog_timer);
-	dev->watchdog_timer.function = entl_watchdog;
-	dev->watchdog_timer.data = (unsigned long)dev;
-	INIT_WORK(&dev->watchdog_task, entl_watchdog_task);
+static ssize_t entl_token_cpu_show( struct device *d, struct device_attribute *attr, char *buf )
+{
+	struct e1000_adapter *adapter = netdev_priv( to_net_dev( d ) ) ;
 
-	init_ENTL_skb_queue( &dev->tx_skb_queue ) ;
-	dev->queue_stopped = 0 ;
+	return sprintf( buf, "%d\n", adapter->entl_dev.placement.token_cpu ) ;
+}
 
-	ENTL_DEBUG("ENTL entl_device_init done\n" );
+static ssize_t entl_token_cpu_store( struct device *d, struct device_attribute *attr, const char *buf, size_t count )
+{
+	struct e1000_adapter *adapter = netdev_priv( to_net_dev( d ) ) ;
+	int cpu, err ;
 
+	if( kstrtoint( buf, 0, &cpu ) ) return -EINVAL ;
+	err = entl_placement_set_token_cpu( &adapter->entl_dev.placement, cpu ) ;
+	return err ? err : count ;
 }
 
-static void entl_device_link_up( entl_device_t *dev ) 
+static ssize_t entl_data_cpus_show( struct device *d, struct device_attribute *attr, char *buf )
+{
+	struct e1000_adapter *adapter = netdev_priv( to_net_dev( d ) ) ;
+
+	return cpumap_print_to_pagebuf( false, buf, &adapter->entl_dev.placement.data_cpus ) ;
+}
+
+static ssize_t entl_data_cpus_store( struct device *d, struct device_attribute *attr, const char *buf, size_t count )
+{
+	struct e1000_adapter *adapter = netdev_priv( to_net_dev( d ) ) ;
+	cpumask_var_t mask ;
+	int err ;
+
+	if( !alloc_cpumask_var( &mask, GFP_KERNEL ) ) return -ENOMEM ;
+	err = cpumask_parse( buf, mask ) ;
+	if( !err ) err = entl_placement_set_data_cpus( &adapter->entl_dev.placement, mask ) ;
+	free_cpumask_var( mask ) ;
+	return err ? err : count ;
+}
+
+static ssize_t entl_layout_show( struct device *d, struct device_attribute *attr, char *buf )
+{
+	return entl_placement_show( buf, PAGE_SIZE ) ;
+}
+
+// token_cpu and data_cpus take -1 and 0 to go back to the layout
+static DEVICE_ATTR( token_cpu, S_IRUGO | S_IWUSR, entl_token_cpu_show, entl_token_cpu_store ) ;
+static DEVICE_ATTR( data_cpus, S_IRUGO | S_IWUSR, entl_data_cpus_show, entl_data_cpus_store ) ;
+static DEVICE_ATTR( layout, S_IRUGO, entl_layout_show, NULL ) ;
+
+static struct attribute *entl_placement_attrs[] = {
+	&dev_attr_token_cpu.attr,
+	&dev_attr_data_cpus.attr,
+	&dev_attr_layout.attr,
+	NULL
+} ;
+
+static const struct attribute_group entl_placement_group = {
+	.name = "entl",
+	.attrs = entl_placement_attrs,
+} ;
+
+// the group goes up with the device in register_netdev, so the files are there on the uevent
+static void entl_placement_sysfs( struct e1000_adapter *adapter )
 {
-	ENTL_DEBUG("ENTL entl_device_link_up called\n", dev->name );
-	entl_link_up( &dev->stm ) ;
-	dev->flag |= ENTL_DEVICE_FLAG_SIGNAL ;
-	mod_timer( &dev->watchdog_timer, jiffies + 1 ) ; // trigger timer	
-	if( dev->stm.current_state.current_state ==  ENTL_STATE_HELLO) {
-		dev->flag |= ENTL_DEVICE_FLAG_HELLO ;
-		mod_timer( &dev->watchdog_timer, jiffies + 1 ) ; // trigger timer	
+	if( adapter->entl_dev.placement_on ) adapter->netdev->sysfs_groups[0] = &entl_placement_group ;
+}
+
+static void entl_placement_start( struct e1000_adapter *adapter )
+{
+	entl_device_t *dev = &adapter->entl_dev ;
+
+	if( !dev->placement_on || dev->placement.apply ) return ;
+
+	dev->placement.name = adapter->netdev->name ;
+	dev->placement.node = dev_to_node( &adapter->pdev->dev ) ;
+	dev->placement.apply = entl_placement_apply ;
+	// a busy poll cpu given for the port is its token core
+	if( dev->busy_poll_cpu >= 0 && cpu_online( dev->busy_poll_cpu ) ) dev->placement.fixed_token_cpu = dev->busy_poll_cpu ;
+	entl_placement_add( &dev->placement ) ;
+}
+
+static void entl_placement_stop( struct e1000_adapter *adapter )
+{
+	entl_device_t *dev = &adapter->entl_dev ;
+
+	if( !dev->placement.apply ) return ;
+	entl_placement_remove( &dev->placement ) ;
+	dev->placement.apply = NULL ;
+}
+
+static void entl_tx_batch_begin( entl_device_t *dev )
+{
+	// the writers check this under tx_ring_lock, entl_tx_batch_end clears it under the lock
+	dev->tx_batch = 1 ;
+}
+
+static void entl_tx_batch_end( entl_device_t *dev )
+{
+	struct e1000_adapter *adapter = container_of( dev, struct e1000_adapter, entl_dev );
+	struct e1000_ring *tx_ring = adapter->tx_ring ;
+	unsigned long flags ;
+
+	spin_lock_irqsave( &adapter->tx_ring_lock, flags ) ;
+	dev->tx_batch = 0 ;
+	if( dev->tx_pending ) {
+		dev->tx_pending = 0 ;
+		if (adapter->flags2 & FLAG2_PCIM2PCI_ARBITER_WA)
+			e1000e_update_tdt_wa(tx_ring, tx_ring->next_to_use);
+		else
+			writel(tx_ring->next_to_use, tx_ring->tail);
+		mmiowb();
 	}
+	spin_unlock_irqrestore( &adapter->tx_ring_lock, flags ) ;
 }
 
-static void dump_state( char *type, entl_state_t *st, int flag )
+static void entl_token_ring_setup( struct e1000_adapter *adapter )
 {
-	ENTL_DEBUG( "%s event_i_know: %d  event_i_sent: %d event_send_next: %d current_state: %d error_flag %x p_error %x error_count %d @ %ld.%ld \n", 
-		type, st->event_i_know, st->event_i_sent, st->event_send_next, st->current_state, st->error_flag, st->p_error_flag, st->error_count, st->update_time.tv_sec, st->update_time.tv_nsec
-	) ;
-	if( st->error_flag ) {
-		ENTL_DEBUG( "  Error time: %ld.%ld\n", st->error_time.tv_sec, st->error_time.tv_nsec ) ;
+	entl_device_t *dev = &adapter->entl_dev ;
+	struct e1000_ring *ring ;
+
+	dev->token_ring = NULL ;
+	// the 82574 is the part with a second tx queue which the driver leaves unused
+	if( !dev->token_queue || adapter->hw.mac.type != e1000_82574 ) return ;
+
+	ring = kzalloc_node( sizeof(struct e1000_ring), GFP_KERNEL, adapter->node ) ;
+	if( !ring ) return ;
+	ring->count = ENTL_TOKEN_RING_COUNT ;
+	ring->adapter = adapter ;
+	if( e1000e_setup_tx_resources( ring ) ) {
+		kfree( ring ) ;
+		return ;
 	}
-#ifdef ENTL_SPEED_CHECK
-	if( flag ) {
-		ENTL_DEBUG( "  interval_time    : %ld.%ld\n", st->interval_time.tv_sec, st->interval_time.tv_nsec ) ;
-		ENTL_DEBUG( "  max_interval_time: %ld.%ld\n", st->max_interval_time.tv_sec, st->max_interval_time.tv_nsec ) ;
-		ENTL_DEBUG( "  min_interval_time: %ld.%ld\n", st->min_interval_time.tv_sec, st->min_interval_time.tv_nsec ) ;
+	dev->token_ring = ring ;
+	ENTL_DEBUG("ENTL %s tokens on tx queue 1\n", adapter->netdev->name );
+}
+
+static void entl_token_ring_configure( struct e1000_adapter *adapter )
+{
+	struct e1000_ring *ring = adapter->entl_dev.token_ring ;
+	struct e1000_hw *hw = &adapter->hw;
+	u64 tdba ;
+
+	if( !ring ) return ;
+
+	tdba = ring->dma ;
+	ew32(TDBAL(1), (tdba & DMA_BIT_MASK(32)));
+	ew32(TDBAH(1), (tdba >> 32));
+	ew32(TDLEN(1), ring->count * sizeof(struct e1000_tx_desc));
+	ew32(TDH(1), 0);
+	ew32(TDT(1), 0);
+	ring->head = adapter->hw.hw_addr + E1000_TDH(1);
+	ring->tail = adapter->hw.hw_addr + E1000_TDT(1);
+
+	// e1000_configure_tx has set TXDCTL(1) the same as queue 0, the queue arbiter needs it enabled
+	ew32(TARC(1), er32(TARC(1)) | ENTL_TARC_ENABLE);
+}
+
+/// free the completed token frames, called with tx_ring_lock held before a new one is queued
+//    tokens go out one at a time, so cleaning here keeps up without an interrupt for queue 1
+static void entl_token_ring_reclaim( struct e1000_ring *ring )
+{
+	unsigned int i = ring->next_to_clean ;
+
+	while( i != ring->next_to_use ) {
+		struct e1000_tx_desc *tx_desc = E1000_TX_DESC(*ring, i);
+		if( !(tx_desc->upper.data & cpu_to_le32(E1000_TXD_STAT_DD)) ) break ;
+		dma_rmb();		/* read buffer_info after the descriptor */
+		e1000_put_txbuf( ring, &ring->buffer_info[i] ) ;
+		tx_desc->upper.data = 0;
+		if( ++i == ring->count ) i = 0 ;
 	}
-#endif
+	ring->next_to_clean = i ;
+}
+
+static void entl_token_ring_reset( struct e1000_adapter *adapter )
+{
+	struct e1000_ring *ring = adapter->entl_dev.token_ring ;
+	unsigned int i ;
+
+	if( !ring ) return ;
+
+	for( i = 0 ; i < ring->count ; i++ ) e1000_put_txbuf( ring, &ring->buffer_info[i] ) ;
+	memset( ring->buffer_info, 0, sizeof(struct e1000_buffer) * ring->count ) ;
+	memset( ring->desc, 0, ring->size ) ;
+	ring->next_to_use = 0 ;
+	ring->next_to_clean = 0 ;
+	// the registers are only mapped once entl_token_ring_configure has run
+	if( ring->head ) {
+		writel(0, ring->head);
+		writel(0, ring->tail);
+	}
+}
+
+static void entl_token_ring_free( struct e1000_adapter *adapter )
+{
+	struct e1000_ring *ring = adapter->entl_dev.token_ring ;
+
+	if( !ring ) return ;
+
+	entl_token_ring_reset( adapter ) ;
+	adapter->entl_dev.token_ring = NULL ;
+	vfree( ring->buffer_info ) ;
+	dma_free_coherent( pci_dev_to_dev(adapter->pdev), ring->size, ring->desc, ring->dma ) ;
+	kfree( ring ) ;
+}
+
+static void entl_device_init( entl_device_t *dev ) 
+{
+	struct e1000_adapter *adapter = container_of( dev, struct e1000_adapter, entl_dev );
+	int i ;
+
+	memset(dev, 0, sizeof(struct entl_device));
+
+	// watchdog timer & task setup, the task counts its cycles
+	entl_link_init( &dev->link, &entl_e1000_link_ops, adapter->netdev ) ;
+	INIT_WORK( &dev->link.watchdog_task, entl_watchdog_task ) ;
+
+	for( i = 0 ; i < ENTL_TX_CLASSES ; i++ ) init_ENTL_skb_queue( &dev->tx_skb_queue[i], E1000_DEFAULT_TXD ) ;
+	spin_lock_init( &dev->alo_lock ) ;
+	dev->placement.fixed_token_cpu = -1 ;
+	dev->placement.token_cpu = -1 ;
+
+	ENTL_DEBUG("ENTL entl_device_init done\n" );
+
+}
+
+static void entl_device_stop( entl_device_t *dev )
+{
+	int i ;
+
+	entl_link_stop( &dev->link ) ;
+	entt_ait_ring_destroy( &dev->link.ait_ring ) ;
+	// the port is closed, so the queues are empty
+	for( i = 0 ; i < ENTL_TX_CLASSES ; i++ ) free_ENTL_skb_queue( &dev->tx_skb_queue[i] ) ;
+}
+
+static void entl_device_link_up( entl_device_t *dev ) 
+{
+	entl_link_carrier_on( &dev->link ) ;
 }
 
 static void entl_device_link_down( entl_device_t *dev ) 
 {
-	ENTL_DEBUG("ENTL entl_device_link_down called\n", dev->name );
-	entl_state_error( &dev->stm, ENTL_ERROR_FLAG_LINKDONW ) ;
-	dev->flag = ENTL_DEVICE_FLAG_SIGNAL ;  // clear other flag and just signal
-	mod_timer( &dev->watchdog_timer, jiffies + 1 ) ; // trigger timer	
+	entl_link_carrier_off( &dev->link ) ;
+}
+
+// entl_link_ops_t read_state, the port part of SIOCDEVPRIVATE_ENTL_RD_CURRENT/RD_ERROR
+static void entl_e1000_read_state( entl_link_t *link, struct entl_ioctl_data *data )
+{
+	entl_device_t *dev = container_of( link, entl_device_t, link ) ;
+	struct e1000_adapter *adapter = container_of( dev, struct e1000_adapter, entl_dev );
+
+	data->link_state = !adapter->hw.mac.get_link_status ;
+	memcpy( data->rtt_hist, dev->rtt_hist, sizeof(data->rtt_hist) ) ;
+	data->busy_polls = dev->busy_polls ;
+	data->hw_rtt_ns = dev->hw_rtt_ns ;
+	data->hw_one_way_ns = dev->hw_one_way_ns ;
 }
 
+// the ENTL/ENTT ioctls which are the same on any port go to entl_link_ioctl
 static int entl_do_ioctl(struct net_device *netdev, struct ifreq *ifr, int cmd) 
 {
 	struct e1000_adapter *adapter = netdev_priv(netdev);
 	entl_device_t *dev = &adapter->entl_dev ;
 	struct e1000_hw *hw = &adapter->hw;
-  	struct entl_ioctl_data entl_data ;
 
 	switch( cmd )
 	{
-	case SIOCDEVPRIVATE_ENTL_RD_CURRENT:
-	{
-		u32 link;
-		//int tt ;
-		struct e1000_hw *hw = &adapter->hw;
-		//tt = hw->mac.get_link_status ;
-    	//hw->mac.get_link_status = 1 ; // AK force to read
-		link = !hw->mac.get_link_status ;
-		//hw->mac.get_link_status = tt ;
-		entl_data.link_state = link ;
-		entl_read_current_state( &dev->stm, &entl_data.state, &entl_data.error_state ) ;
-		entl_data.num_queued = entl_num_queued( &dev->stm ) ;
-		//entl_data.icr = er32(ICR);
-		//entl_data.ctrl = er32(CTRL);
-		//entl_data.ims = er32(IMS);
-		copy_to_user(ifr->ifr_data, &entl_data, sizeof(struct entl_ioctl_data));
-		//ENTL_DEBUG("ENTL %s ioctl reading current state on %d icr %08x ctrl %08x ims %08x\n", dev->name, link, entl_data.icr, entl_data.ctrl, entl_data.ims );
-		//dump_state( "rd current", &entl_data.state, 1 ) ;
-		//dump_state( "rd error", &entl_data.error_state, 0 ) ;		
-	}
-		break;		
-	case SIOCDEVPRIVATE_ENTL_RD_ERROR:
-	{
-		u32 link;
-		//int tt ;
-		struct e1000_hw *hw = &adapter->hw;
-		//tt = hw->mac.get_link_status ;
-    	//hw->mac.get_link_status = 1 ; // AK force to read
-		link = !hw->mac.get_link_status ;
-		//ENTL_DEBUG("ENTL %s ioctl reading error state on link %d\n", dev->name, link );
-		//hw->mac.get_link_status = hw->mac.get_link_status ;
-		entl_data.link_state = link ;
-		entl_read_error_state( &dev->stm, &entl_data.state, &entl_data.error_state ) ;
-		entl_data.num_queued = entl_num_queued( &dev->stm ) ;
-		//entl_data.icr = er32(ICR);
-		//entl_data.ctrl = er32(CTRL);
-		//entl_data.ims = er32(IMS);
-		copy_to_user(ifr->ifr_data, &entl_data, sizeof(struct entl_ioctl_data));
-		dump_state( "current", &entl_data.state, 1 ) ;
-		dump_state( "error", &entl_data.error_state, 0 ) ;			
-	}
-
-		break;
-	case SIOCDEVPRIVATE_ENTL_SET_SIGRCVR:
-		copy_from_user(&entl_data, ifr->ifr_data, sizeof(struct entl_ioctl_data) ) ;
-		ENTL_DEBUG("ENTL %s ioctl user_pid %d is set\n", netdev->name, entl_data.pid );
-		dev->user_pid = entl_data.pid ;
-		break;
-	case SIOCDEVPRIVATE_ENTL_GEN_SIGNAL:
-		ENTL_DEBUG("ENTL %s ioctl got SIOCDEVPRIVATE_ENTL_GEN_SIGNAL %d %d %d \n", netdev->name, dev->tx_skb_queue.count, dev->tx_skb_queue.head, dev->tx_skb_queue.tail );
-		//dev->flag |= ENTL_DEVICE_FLAG_SIGNAL ;
-		//mod_timer( &dev->watchdog_timer, jiffies + 1 ) ; // trigger timer		
-		break ;		
 	case SIOCDEVPRIVATE_ENTL_DO_INIT:
 		ENTL_DEBUG("ENTL %s ioctl initialize the device\n", netdev->name );
-		adapter->entl_flag = 1 ;
+		entl_port_enable( adapter ) ;
 		entl_e1000_configure( adapter ) ;
 		u32 icr = er32(ICR);
 		u32 ctrl = er32(CTRL);
 		u32 ims = er32(IMS);
 		ENTL_DEBUG("ENTL %s ioctl initialized the device with icr %08x ctrl %08x ims %08x\n", netdev->name, icr, ctrl, ims );
 		break ;
-	case SIOCDEVPRIVATE_ENTT_SEND_AIT:
+	case SIOCDEVPRIVATE_ENTL_ALO_READ_REGS:
 	{
-		struct entt_ioctl_ait_data* ait_data ;
-		int ret ;
-	    ait_data = kzalloc( sizeof(struct entt_ioctl_ait_data), GFP_ATOMIC );
-		copy_from_user(ait_data, ifr->ifr_data, sizeof(struct entt_ioctl_ait_data) ) ;
-		ret = entl_send_AIT_message( &dev->stm, ait_data ) ;
-		ENTL_DEBUG("ENTL %s ioctl send %d byte AIT, %d left\n", netdev->name, ait_data->message_len, ret );
-		ait_data->num_messages = ret ; // return how many buffer left
-		copy_to_user(ifr->ifr_data, ait_data, sizeof(struct entt_ioctl_ait_data));
-		if( ret < 0 ) {
-			// error, dealloc data
-			kfree(ait_data) ;
-		}
+		entl_alo_regs_t regs ;
+		unsigned long flags ;
+		spin_lock_irqsave( &dev->alo_lock, flags ) ;
+		regs = dev->alo_regs ;
+		dev->alo_regs.flags = 0 ;
+		spin_unlock_irqrestore( &dev->alo_lock, flags ) ;
+		if( copy_to_user(ifr->ifr_data, &regs, sizeof(regs)) ) return -EFAULT ;
 	}
 		break ;
-	case SIOCDEVPRIVATE_ENTT_READ_AIT:
+	case SIOCDEVPRIVATE_ENTL_ALO_WRITE_REG:
 	{
-		struct entt_ioctl_ait_data* ait_data ;
-		ait_data = entl_read_AIT_message( &dev->stm ) ;
-		if( ait_data ) {
-			ENTL_DEBUG("ENTL %s ioctl got %d byte AIT, %d left\n", netdev->name, ait_data->message_len, ait_data->num_messages );
-			copy_to_user(ifr->ifr_data, ait_data, sizeof(struct entt_ioctl_ait_data));
-			kfree(ait_data) ;
-		}
-		else {
-			struct entt_ioctl_ait_data dt ;
-			dt.num_messages = 0 ;
-			dt.message_len = 0 ;
-			dt.num_queued = entl_num_queued( &dev->stm ) ;
-			copy_to_user(ifr->ifr_data, &dt, sizeof(struct entt_ioctl_ait_data));
-		}
+		entl_alo_reg_t reg ;
+		unsigned long flags ;
+		if( copy_from_user(&reg, ifr->ifr_data, sizeof(reg)) ) return -EFAULT ;
+		if( reg.index >= ENTL_ALO_NUM_REGS ) return -EINVAL ;
+		spin_lock_irqsave( &dev->alo_lock, flags ) ;
+		dev->alo_regs.regs[reg.index] = reg.reg ;
+		spin_unlock_irqrestore( &dev->alo_lock, flags ) ;
+	}
+		break ;
+	case SIOCDEVPRIVATE_ENTL_ALO_RESULT:
+	{
+		entl_alo_result_t res ;
+		unsigned long flags ;
+		spin_lock_irqsave( &dev->alo_lock, flags ) ;
+		res = dev->alo_result ;
+		spin_unlock_irqrestore( &dev->alo_lock, flags ) ;
+		res.count = (u32)READ_ONCE( dev->stats.alo_results ) ;
+		if( copy_to_user(ifr->ifr_data, &res, sizeof(res)) ) return -EFAULT ;
 	}
 		break ;
 	default:
-		ENTL_DEBUG("ENTL %s ioctl error: undefined cmd %d\n", netdev->name, cmd);
-		break;
+		return entl_link_ioctl( &dev->link, ifr, cmd ) ;
 	}
 	return 0 ;
 }
 
-//static void entl_do_user_signal( entl_device_t *dev ) 
-//{
+// the tokens carry no protocol type and the data frames are ECLP/ECLD, anything else is stray traffic.
+//   Called before the skb is touched, so a broadcast storm costs a compare per frame
+static bool entl_rx_frame_wanted( entl_device_t *dev, const u8 *frame, unsigned int len )
+{
+	const struct ethhdr *eth = (const struct ethhdr *)frame ;
+
+	if( likely(len >= ETH_HLEN && (eth->h_proto == 0 || eth->h_proto == ETH_P_ECLP || eth->h_proto == ETH_P_ECLD)) ) return true ;
+	// the peer's bypass frames, they come with a NOP address
+	if( dev->bypass_type && len >= ETH_HLEN && eth->h_proto == htons( dev->bypass_type ) ) return true ;
+	ENTL_STAT_INC( dev, rx_drop_non_ec ) ;
+	return false ;
+}
+
+// The AIT is the ALO operation: run it on our registers now, as the AIT arrives on Ah, and have the result
+//   go back in the Ack we send next. The peer has it when it leaves Am. When the exchange breaks off the
+//   peer sends the operation again after Hello, so the one with the seq of the last one run only gets that
+//   result back, ADD, SWAP and CAS are not applied twice
+static bool entl_alo_execute( entl_device_t *dev, const struct entt_ioctl_ait_data *ait_data )
+{
+	struct e1000_adapter *adapter = container_of( dev, struct e1000_adapter, entl_dev );
+	entl_alo_op_t op ;
+	entl_alo_result_t res ;
+	unsigned long flags ;
+	bool replay ;
+
+	if( ait_data->message_len < sizeof(op) ) return false ;
+	memcpy( &op, ait_data->data, sizeof(op) ) ;
+	if( op.magic != ENTL_ALO_MAGIC ) return false ;
+
+	spin_lock_irqsave( &dev->alo_lock, flags ) ;
+	replay = dev->alo_last.magic == ENTL_ALO_MAGIC && dev->alo_last.seq == op.seq && dev->alo_last.op == op.op && dev->alo_last.index == op.index ;
+	if( replay ) {
+		res = dev->alo_last ;
+	}
+	else {
+		memset( &res, 0, sizeof(res) ) ;
+		res.magic = ENTL_ALO_MAGIC ;
+		res.op = op.op ;
+		res.index = op.index ;
+		res.seq = op.seq ;
+		if( op.index >= ENTL_ALO_NUM_REGS || op.op > ENTL_ALO_SWAP ) {
+			res.status = ENTL_ALO_STATUS_INVALID ;
+		}
+		else {
+			u64 *reg = &dev->alo_regs.regs[op.index] ;
+			res.value = *reg ;
+			switch( op.op ) {
+			case ENTL_ALO_WRITE:
+			case ENTL_ALO_SWAP:
+				*reg = op.operand ;
+				break ;
+			case ENTL_ALO_ADD:
+				*reg += op.operand ;
+				break ;
+			case ENTL_ALO_CAS:
+				if( *reg == op.compare ) *reg = op.operand ;
+				else res.status = ENTL_ALO_STATUS_MISMATCH ;
+				break ;
+			default:
+				break ;
+			}
+			if( op.op != ENTL_ALO_READ && res.status == ENTL_ALO_STATUS_OK ) dev->alo_regs.flags |= 1u << op.index ;
+		}
+		dev->alo_last = res ;
+	}
+	spin_unlock_irqrestore( &dev->alo_lock, flags ) ;
+
+	spin_lock_irqsave( &adapter->tx_ring_lock, flags ) ;
+	dev->alo_reply = res ;
+	dev->alo_reply_pending = 1 ;
+	spin_unlock_irqrestore( &adapter->tx_ring_lock, flags ) ;
+	if( !replay ) ENTL_STAT_INC( dev, alo_ops ) ;
+	return true ;
+}
+
+// entl_link_ops_t ait_consume
+static bool entl_e1000_ait_consume( entl_link_t *link, const struct entt_ioctl_ait_data *ait_data )
+{
+	return entl_alo_execute( container_of( link, entl_device_t, link ), ait_data ) ;
+}
 
-//	dev->flag |= ENTL_DEVICE_FLAG_SIGNAL ;
-//	mod_timer( &dev->watchdog_timer, jiffies + 1 ) ; // trigger timer
-//}
+static void entl_alo_result_received( entl_device_t *dev, const u8 *data )
+{
+	entl_alo_result_t res ;
+	unsigned long flags ;
+
+	memcpy( &res, data, sizeof(res) ) ;
+	if( res.magic != ENTL_ALO_MAGIC ) return ;
+	spin_lock_irqsave( &dev->alo_lock, flags ) ;
+	dev->alo_result = res ;
+	spin_unlock_irqrestore( &dev->alo_lock, flags ) ;
+	ENTL_STAT_INC( dev, alo_results ) ;
+}
 
 // process received packet, if not message only, return true to let upper side forward this packet
 //   It is assumed that this is called on ISR context.
 static bool entl_device_process_rx_packet( entl_device_t *dev, struct sk_buff *skb )
 {
-	struct e1000_adapter *adapter = container_of( dev, struct e1000_adapter, entl_dev );
+	return entl_device_process_rx( dev, skb->data, skb->len ) ;
+}
+
+// same on the frame still in the rx buffer, so the page recycling path needs no skb for the tokens
+static bool entl_device_process_rx( entl_device_t *dev, const u8 *frame, unsigned int len )
+{
 	bool retval = true ;
-	struct ethhdr *eth = (struct ethhdr *)skb->data ;
 	int result ;
+	cycles_t start = entl_cycles_start() ;
+	int cls ;
+	u16 d_u_addr = get_unaligned_be16( frame ) ;
 
-    u16 s_u_addr; 
-    u32 s_l_addr;	
-    u16 d_u_addr; 
-    u32 d_l_addr;	
+    if( d_u_addr & ENTL_MESSAGE_ONLY_U ) retval = false ; // this is message only packet
 
-    s_u_addr = (u16)eth->h_source[0] << 8 | eth->h_source[1] ;
-    s_l_addr = (u32)eth->h_source[2] << 24 | (u32)eth->h_source[3] << 16 | (u32)eth->h_source[4] << 8 | (u32)eth->h_source[5] ;
-    d_u_addr = (u16)eth->h_dest[0] << 8 | eth->h_dest[1] ;
-    d_l_addr = (u32)eth->h_dest[2] << 24 | (u32)eth->h_dest[3] << 16 | (u32)eth->h_dest[4] << 8 | (u32)eth->h_dest[5] ;
+    // inputs for the interrupt moderation
+    if( retval ) dev->itr_data_frames++ ;
+    else if( (d_u_addr & ENTL_MESSAGE_MASK) != ENTL_MESSAGE_NOP_U && (d_u_addr & ENTL_MESSAGE_MASK) != ENTL_MESSAGE_HELLO_U ) {
+    	entl_itr_token_received( dev ) ;
+    	if( (d_u_addr & ENTL_MESSAGE_MASK) == ENTL_MESSAGE_ACK_U && len >= ETH_HLEN + sizeof(entl_alo_result_t) ) entl_alo_result_received( dev, frame + ETH_HLEN ) ;
+    	if( dev->hwts_on ) entl_hwts_token_received( dev, frame, len ) ;
+    }
 
-    if( d_u_addr & ENTL_MESSAGE_ONLY_U ) retval = false ; // this is message only packet
+    // the state machine, the AIT and the answer, entl_e1000_send_data sends the data waiting for the token
+    result = entl_link_rx( &dev->link, frame, entl_link_copy_linear, frame + ETH_HLEN, len - ETH_HLEN ) ;
+    if( retval ) cls = ENTL_CYCLES_RX_DATA ;
+    else if( result != ENTL_ACTION_ERROR && (result & (ENTL_ACTION_PROC_AIT | ENTL_ACTION_SEND_AIT)) ) cls = ENTL_CYCLES_AIT ;
+    else cls = ENTL_CYCLES_TOKEN ;
 
-	else ENTL_DEBUG("ENTL %s entl_device_process_rx_packet got %d s: %04x %08x d: %04x %08x t:%04x\n", skb->len, adapter->netdev->name, s_u_addr, s_l_addr, d_u_addr, d_l_addr, eth->h_proto );
+	entl_cycles_stop( dev, cls, start ) ;
+	return retval ;
+
+}
 
-    result = entl_received( &dev->stm, s_u_addr, s_l_addr, d_u_addr, d_l_addr ) ;
+// descriptors e1000_xmit_frame takes for the frame, counting the context descriptor
+static int entl_tx_desc_count( struct e1000_adapter *adapter, struct sk_buff *skb )
+{
+	int count = 2 + DIV_ROUND_UP( skb_headlen(skb), adapter->tx_fifo_limit ) ;
+	int f ;
 
-	//ENTL_DEBUG("ENTL %s entl_device_process_rx_packet got entl_received result %d\n", dev->name, result);
-    if( result == ENTL_ACTION_ERROR ) {
-    	// error, need to send signal & hello, 
-		dev->flag |= ENTL_DEVICE_FLAG_HELLO | ENTL_DEVICE_FLAG_SIGNAL ;
-		mod_timer( &dev->watchdog_timer, jiffies + 1 ) ; // trigger timer
+	for( f = 0 ; f < skb_shinfo(skb)->nr_frags ; f++ ) {
+		count += DIV_ROUND_UP( skb_frag_size(&skb_shinfo(skb)->frags[f]), adapter->tx_fifo_limit ) ;
 	}
-	else if( result == ENTL_ACTION_SIG_ERR ) {  // request for signal as error flag is set
-		dev->flag |= ENTL_DEVICE_FLAG_SIGNAL ;
-		mod_timer( &dev->watchdog_timer, jiffies + 1 ) ; // trigger timer		
+	return count ;
+}
+
+// room on the tx ring for the frame plus the 2 descriptor gap, e1000_xmit_frame does not stop
+//   an ENTL port itself
+static bool entl_tx_data_room( struct e1000_adapter *adapter, struct sk_buff *skb )
+{
+	unsigned long flags ;
+	bool room ;
+
+	spin_lock_irqsave( &adapter->tx_ring_lock, flags ) ;
+	room = e1000_desc_unused( adapter->tx_ring ) >= entl_tx_desc_count( adapter, skb ) + 2 ;
+	spin_unlock_irqrestore( &adapter->tx_ring_lock, flags ) ;
+	return room ;
+}
+
+// entl_link_ops_t send_data, the token goes out on the first data frame waiting and the rest of
+//   the credit as NOP frames, as the state machine is on Receive state then. The burst stops
+//   where the tx ring runs short, the rest stays queued for the next token
+static bool entl_e1000_send_data( entl_link_t *link )
+{
+	entl_device_t *dev = container_of( link, entl_device_t, link ) ;
+	struct e1000_adapter *adapter = container_of( dev, struct e1000_adapter, entl_dev );
+	// GSO skbs are segmented in entl_tx_transmit, so each one can carry the token
+	int cls ;
+	struct sk_buff *dt = entl_tx_peek( dev, &cls );
+	u32 frames = 1 ;
+	u32 bytes ;
+
+	// without room the token goes alone as a message only frame
+	if( !dt || !entl_tx_data_room( adapter, dt ) ) return false ;
+	bytes = dt->len ;
+	entl_tx_pop( dev, cls ) ;
+	e1000_xmit_frame( dt, adapter->netdev ) ;  // this one carries the token
+	while( frames < dev->burst_frames && NULL != (dt = entl_tx_peek( dev, &cls )) ) {
+		if( dev->burst_bytes && bytes + dt->len > dev->burst_bytes ) break ;
+		if( !entl_tx_data_room( adapter, dt ) ) break ;
+		entl_tx_pop( dev, cls ) ;
+		bytes += dt->len ;
+		frames++ ;
+		e1000_xmit_frame( dt, adapter->netdev ) ;
 	}
-	else {
-		if( result & ENTL_ACTION_PROC_AIT ) {
-	    	// AIT message is received, put in to the receive buffer
-	    	struct entt_ioctl_ait_data *ait_data ;
-	    	unsigned int len = skb->len ;
-	    	char *cp = skb->data + sizeof(struct ethhdr) ;
-			//ENTL_DEBUG("entl_device_process_rx_packet %02x %02x %02x %02x %02x %02x %02x %02x \n", cp[0], cp[1],cp[2],cp[3],cp[4],cp[5],cp[6],cp[7] );
-	    	
-	    	ait_data = kzalloc( sizeof(struct entt_ioctl_ait_data), GFP_ATOMIC );
-			//ENTL_DEBUG("ENTL %s entl_device_process_rx_packet got skb len %d\n", dev->name, len );
-	    	if( len > sizeof(struct ethhdr) ) {
-	    		unsigned char *data = skb->data + sizeof(struct ethhdr) ;
-	    		memcpy( &ait_data->message_len, data, sizeof(u32)) ;
-	    		if( ait_data->message_len && ait_data->message_len < MAX_AIT_MESSAGE_SIZE ) 
-	    		{
-					//ENTL_DEBUG("ENTL %s entl_device_process_rx_packet got message_len %d\n", dev->name, ait_data->message_len );
-	    			memcpy( ait_data->data, data + sizeof(u32), ait_data->message_len ) ;
-	    		}
-	    		else {
-					ENTL_DEBUG("ENTL %s entl_device_process_rx_packet got too big message_len %d\n", adapter->netdev->name, ait_data->message_len );
-	    			ait_data->message_len = 0 ;
-	    		}
-	    	}
-	    	entl_new_AIT_message( &dev->stm, ait_data ) ;
-			//ENTL_DEBUG("ENTL %s entl_device_process_rx_packet got ATI len %d\n", dev->name, ait_data->message_len );
-		}
-		if( result & ENTL_ACTION_SIG_AIT ) {
-			dev->flag |= ENTL_DEVICE_FLAG_SIGNAL2 ;
-		}
-	    if( result & ENTL_ACTION_SEND ) {
-	    	int ret ;
-	    	// need to send message
-
-	    	// SEND_DAT flag is set on SEND state to check if TX queue has data
-	    	if( result & ENTL_ACTION_SEND_DAT &&  ENTL_skb_queue_has_data( &dev->tx_skb_queue ) ) {
-	    		// TX queue has data, so transfer with data
-				struct sk_buff *dt = pop_front_ENTL_skb_queue( &dev->tx_skb_queue );
-    			while( NULL != dt && skb_is_gso(dt) ) {  // GSO can't be used for ENTL 
-					ENTL_DEBUG("ENTL %s entl_device_process_rx_packet emit gso packet\n", adapter->netdev->name );    				
-					e1000_xmit_frame( dt, adapter->netdev ) ;
-					dt = pop_front_ENTL_skb_queue( &dev->tx_skb_queue );
-    			}
-	    		if( dt ) {
-	    			ENTL_DEBUG("ENTL %s entl_device_process_rx_packet emit packet len %d count %d head %d tail %d\n", adapter->netdev->name , dt->len, dev->tx_skb_queue.count, dev->tx_skb_queue.head, dev->tx_skb_queue.tail );    				
-					e1000_xmit_frame( dt, adapter->netdev ) ;
-	    		}
-	    		else {
-	    			// tx queue becomes empty, so inject a new packet
-	    			ret = entl_next_send( &dev->stm, &d_u_addr, &d_l_addr ) ;
-			    	if( (d_u_addr & (u16)ENTL_MESSAGE_MASK) != ENTL_MESSAGE_NOP_U ) {  // last minute check
-			    		unsigned long flags ;
-						spin_lock_irqsave( &adapter->tx_ring_lock, flags ) ;
-			    		result = inject_message( dev, d_u_addr, d_l_addr, ret ) ;
-			    		spin_unlock_irqrestore( &adapter->tx_ring_lock, flags ) ;
-			    		// if failed to inject message, so invoke the task
-			    		if( result == 1 ) {
-			    			// resource error, so retry
-			    			dev->u_addr = d_u_addr ;
-			    			dev->l_addr = d_l_addr ;
-			    			dev->action = ret ;
-			    			dev->flag |= ENTL_DEVICE_FLAG_RETRY ;
-							mod_timer( &dev->watchdog_timer, jiffies + 1 ) ; // trigger timer
-			    		}
-			    		else if( result == -1 ) {
-			     			entl_state_error( &dev->stm, ENTL_ERROR_FATAL ) ;
-			   				dev->flag |= ENTL_DEVICE_FLAG_SIGNAL ;
-							mod_timer( &dev->watchdog_timer, jiffies + 1 ) ; // trigger timer
-			    		}
-			    		else {
-			    			// clear watchdog flag
-							dev->flag &= ~(__u32)ENTL_DEVICE_FLAG_WAITING ;
-			    		}
-			    	}			   	
-	    		}
-	    		// netif queue handling for flow control
-	    		if( dev->queue_stopped && ENTL_skb_queue_unused( &dev->tx_skb_queue ) > 2 ) {
-					netif_start_queue(adapter->netdev);
-					dev->queue_stopped = 0 ;
-				}
-	    	}
-	    	else {
-		    	ret = entl_next_send( &dev->stm, &d_u_addr, &d_l_addr ) ;
-		    	if( (d_u_addr & (u16)ENTL_MESSAGE_MASK) != ENTL_MESSAGE_NOP_U ) {  // last minute check
-		    		unsigned long flags ;
-					spin_lock_irqsave( &adapter->tx_ring_lock, flags ) ;
-		    		result = inject_message( dev, d_u_addr, d_l_addr, ret ) ;
-		    		spin_unlock_irqrestore( &adapter->tx_ring_lock, flags ) ;
-		    		// if failed to inject message, so invoke the task
-		    		if( result == 1 ) {
-		    			// resource error, so retry
-		    			dev->u_addr = d_u_addr ;
-		    			dev->l_addr = d_l_addr ;
-		    			dev->action = ret ;
-		    			dev->flag |= ENTL_DEVICE_FLAG_RETRY ;
-						mod_timer( &dev->watchdog_timer, jiffies + 1 ) ; // trigger timer
-		    		}
-		    		else if( result == -1 ) {
-		     			entl_state_error( &dev->stm, ENTL_ERROR_FATAL ) ;
-		   				dev->flag |= ENTL_DEVICE_FLAG_SIGNAL ;
-						mod_timer( &dev->watchdog_timer, jiffies + 1 ) ; // trigger timer
-		    		}
-		    		else {
-		    			// clear watchdog flag
-						dev->flag &= ~(__u32)ENTL_DEVICE_FLAG_WAITING ;
-		    		}
-		    	}			    		
-	    	}
-
-	    }
+	link->data_tokens++ ;
+	link->data_frames += frames ;
 
-    }
+	// netif queue handling for flow control, the producer re-checks after stopping so a wakeup is not lost
+	smp_mb() ;
+	if( netif_queue_stopped(adapter->netdev) && entl_tx_queue_room( dev ) >= ENTL_TX_WAKE_THRESHOLD ) {
+		netif_wake_queue(adapter->netdev);
+	}
+	return true ;
+}
 
-	return retval ;
+static const entl_link_ops_t entl_e1000_link_ops = {
+	.inject = entl_e1000_inject,
+	.tx_ready = entl_e1000_tx_ready,
+	.send_data = entl_e1000_send_data,
+	.read_state = entl_e1000_read_state,
+	.ait_consume = entl_e1000_ait_consume,
+} ;
 
+// a data frame which carries no token, the peer's state machine skips the NOP address
+static void entl_tx_set_nop( struct ethhdr *eth )
+{
+	static const unsigned char nop_addr[ETH_ALEN] = { ENTL_MESSAGE_NOP_U >> 8, ENTL_MESSAGE_NOP_U & 0xff, 0, 0, 0, 0 } ;
+
+	memcpy( eth->h_dest, nop_addr, ETH_ALEN ) ;
 }
 
 // process packet being sent. The ENTL message can only be ent over the single (non MSS) packet
 //  Assuming this is called from non-interrupt context
 static void entl_device_process_tx_packet( entl_device_t *dev, struct sk_buff *skb )
 {
-	u16 u_addr;
-	u32 l_addr;
-	unsigned char d_addr[ETH_ALEN] ;
 	struct ethhdr *eth = (struct ethhdr *)skb->data ;
+	cycles_t start ;
 
+	// bypass frames have the NOP address already, and come from the tx path rather than the rx path.
+	//   The gated GSO skbs were segmented in entl_tx_queue_gso, so each frame here can carry the token
+	if( ENTL_TX_CB(skb)->bypass ) return ;
 
-	if( skb_is_gso(skb) ) {
-		// MSS packet can't be used for ENTL message (will use a header over multiple packets)
-		u_addr = ENTL_MESSAGE_NOP_U ;
-		l_addr = 0 ;  
-		d_addr[0] = (u_addr >> 8) ; 
-		d_addr[1] = u_addr ;
-		d_addr[2] = l_addr >> 24 ;
-		d_addr[3] = l_addr >> 16;
-		d_addr[4] = l_addr >> 8;
-		d_addr[5] = l_addr ;		
-		memcpy(eth->h_dest, d_addr, ETH_ALEN);
-		ENTL_DEBUG("ENTL %s entl_device_process_tx_packet got a gso packet\n", dev->name );
-	}
-	else {
-	    int ret = entl_next_send_tx( &dev->stm, &u_addr, &l_addr ) ;
-	    if( ret & ENTL_ACTION_SIG_AIT ) {
-			dev->flag |= ENTL_DEVICE_FLAG_SIGNAL2 ;  // AIT send completion signal
-		}
-		d_addr[0] = (u_addr >> 8) ; 
-		d_addr[1] = u_addr ;
-		d_addr[2] = l_addr >> 24 ;
-		d_addr[3] = l_addr >> 16;
-		d_addr[4] = l_addr >> 8;
-		d_addr[5] = l_addr ;		
-		memcpy(eth->h_dest, d_addr, ETH_ALEN);
-		if( u_addr != ENTL_MESSAGE_NOP_U ) {
-			dev->flag &= ~(__u32)ENTL_DEVICE_FLAG_WAITING ;			
-		}
-		ENTL_DEBUG("ENTL %s entl_device_process_tx_packet got a single packet with %04x %08x t:%04x\n", dev->name, u_addr, l_addr, eth->h_proto );
-	}
-
+	start = entl_cycles_start() ;
+	entl_link_tx_token( &dev->link, eth ) ;
+	entl_cycles_stop( dev, ENTL_CYCLES_TX_DATA, start ) ;
 }
 
 /**
@@ -649,7 +1251,10 @@ static void entl_e1000e_set_rx_mode(struct net_device *netdev)
 	/* Check for Promiscuous and All Multicast modes */
 	rctl = er32(RCTL);                                           
 
-	rctl |= (E1000_RCTL_UPE | E1000_RCTL_MPE);           // ENTL: We need to set this
+	rctl |= E1000_RCTL_UPE ;           // ENTL: We need to set this
+	// the tokens are never group addressed, so with the filter on the MAC drops broadcast and multicast
+	if( adapter->entl_dev.rx_filter ) rctl &= ~(E1000_RCTL_MPE | E1000_RCTL_BAM) ;
+	else rctl |= E1000_RCTL_MPE | E1000_RCTL_BAM ;
 #ifdef HAVE_VLAN_RX_REGISTER
 	rctl &= ~E1000_RCTL_VFE;
 #else
@@ -705,6 +1310,7 @@ static void entl_e1000_setup_rctl(struct e1000_adapter *adapter)
 	rctl |= E1000_RCTL_EN | E1000_RCTL_BAM |
 	    E1000_RCTL_LBM_NO | E1000_RCTL_RDMTS_HALF |
 	    (adapter->hw.mac.mc_filter_type << E1000_RCTL_MO_SHIFT);
+	if( adapter->entl_dev.rx_filter ) rctl &= ~E1000_RCTL_BAM ;
 
 	/* Do not Store bad packets */
 	rctl &= ~E1000_RCTL_SBP;
@@ -849,6 +1455,287 @@ static void entl_e1000_setup_rctl(struct e1000_adapter *adapter)
 	adapter->flags &= ~FLAG_RESTART_NOW;
 }
 
+#ifdef CONFIG_E1000E_NAPI
+/**
+ * entl_alloc_rx_buffers - give half pages back to the hardware
+ * @rx_ring: Rx descriptor ring
+ * @cleaned_count: number of buffers to replace
+ * @gfp: flags for allocation
+ *
+ * A buffer whose page is still mapped is only synced back to the device,
+ * a new page is allocated and mapped only when the slot lost its page.
+ **/
+static void entl_alloc_rx_buffers( struct e1000_ring *rx_ring, int cleaned_count, gfp_t gfp )
+{
+	struct e1000_adapter *adapter = rx_ring->adapter;
+	struct pci_dev *pdev = adapter->pdev;
+	union e1000_rx_desc_extended *rx_desc;
+	struct e1000_buffer *buffer_info;
+	unsigned int i;
+
+	i = rx_ring->next_to_use;
+	buffer_info = &rx_ring->buffer_info[i];
+
+	while (cleaned_count--) {
+		if( buffer_info->dma ) {
+			dma_sync_single_range_for_device( pci_dev_to_dev(pdev), buffer_info->dma,
+							  buffer_info->page_offset, ENTL_RX_BUFSZ, DMA_FROM_DEVICE ) ;
+		}
+		else {
+			if( !buffer_info->page ) {
+				buffer_info->page = alloc_pages_node( adapter->node, gfp, 0 ) ;
+				if (unlikely(!buffer_info->page)) {
+					adapter->alloc_rx_buff_failed++;
+					break;
+				}
+				buffer_info->page_offset = 0 ;
+				ENTL_STAT_INC( &adapter->entl_dev, rx_page_alloc ) ;
+			}
+			buffer_info->dma = dma_map_page( pci_dev_to_dev(pdev), buffer_info->page, 0,
+							 PAGE_SIZE, DMA_FROM_DEVICE ) ;
+			if (dma_mapping_error(pci_dev_to_dev(pdev), buffer_info->dma)) {
+				dev_err(pci_dev_to_dev(pdev), "Rx DMA map failed\n");
+				buffer_info->dma = 0;
+				adapter->rx_dma_failed++;
+				break;
+			}
+		}
+
+		// the write back overwrote the address, so it is written every time
+		rx_desc = E1000_RX_DESC_EXT(*rx_ring, i);
+		rx_desc->read.buffer_addr = cpu_to_le64(buffer_info->dma + buffer_info->page_offset);
+
+		if (unlikely(!(i & (E1000_RX_BUFFER_WRITE - 1)))) {
+			/* Force memory writes to complete before letting h/w
+			 * know there are new descriptors to fetch.
+			 */
+			wmb();
+			if (adapter->flags2 & FLAG2_PCIM2PCI_ARBITER_WA)
+				e1000e_update_rdt_wa(rx_ring, i);
+			else
+				writel(i, rx_ring->tail);
+		}
+		i++;
+		if (i == rx_ring->count)
+			i = 0;
+		buffer_info = &rx_ring->buffer_info[i];
+	}
+
+	rx_ring->next_to_use = i;
+}
+
+// the rest of the frame went up as a page frag, keep the page if the stack let go of the other half
+static void entl_rx_page_release( struct e1000_adapter *adapter, struct e1000_buffer *buffer_info )
+{
+#if (PAGE_SIZE < 8192)
+	if( page_count( buffer_info->page ) == 1 && page_to_nid( buffer_info->page ) == numa_node_id() ) {
+		// one reference for the stack, ours stays on the ring
+		get_page( buffer_info->page ) ;
+		buffer_info->page_offset ^= ENTL_RX_BUFSZ ;
+		ENTL_STAT_INC( &adapter->entl_dev, rx_page_reuse ) ;
+		return ;
+	}
+#endif
+	dma_unmap_page( pci_dev_to_dev(adapter->pdev), buffer_info->dma, PAGE_SIZE, DMA_FROM_DEVICE ) ;
+	buffer_info->dma = 0 ;
+	buffer_info->page = NULL ;
+}
+
+// hand the batch of one poll to the rx hook, and deliver what it gives back for this host
+static void entl_rx_hook_run( struct e1000_adapter *adapter, entl_rx_hook_t *hook, struct sk_buff_head *batch )
+{
+	entl_device_t *dev = &adapter->entl_dev ;
+	struct sk_buff_head host ;
+	struct sk_buff *skb ;
+
+	WRITE_ONCE( dev->stats.rx_hook_frames, dev->stats.rx_hook_frames + skb_queue_len( batch ) ) ;
+	ENTL_STAT_INC( dev, rx_hook_batches ) ;
+	__skb_queue_head_init( &host ) ;
+	hook->receive( hook, batch, &host ) ;
+
+	WRITE_ONCE( dev->stats.rx_hook_host, dev->stats.rx_hook_host + skb_queue_len( &host ) ) ;
+	while( NULL != (skb = __skb_dequeue( &host )) ) {
+		skb->protocol = eth_type_trans( skb, adapter->netdev ) ;
+		napi_gro_receive( &adapter->napi, skb ) ;
+	}
+}
+
+/**
+ * entl_clean_rx_irq - ENTL receive on recycled half pages
+ * @rx_ring: Rx descriptor ring
+ *
+ * Same as e1000_clean_rx_irq, but the frame is handed to the state machine
+ * from the rx buffer. The message only tokens never get an skb and their
+ * buffer goes back to the ring as is, the skb is built only for the frames
+ * going up the stack, or to the rx hook when one is attached.
+ **/
+static bool entl_clean_rx_irq( struct e1000_ring *rx_ring, int *work_done, int work_to_do )
+{
+	struct e1000_adapter *adapter = rx_ring->adapter;
+	struct net_device *netdev = adapter->netdev;
+	struct pci_dev *pdev = adapter->pdev;
+	entl_device_t *dev = &adapter->entl_dev ;
+	entl_rx_hook_t *hook = rcu_dereference_bh( dev->rx_hook ) ;
+	struct sk_buff_head batch ;
+	union e1000_rx_desc_extended *rx_desc, *next_rxd;
+	struct e1000_buffer *buffer_info, *next_buffer;
+	u32 length, staterr;
+	unsigned int i;
+	int cleaned_count = 0;
+	bool cleaned = false;
+	unsigned int total_rx_bytes = 0, total_rx_packets = 0;
+
+	__skb_queue_head_init( &batch ) ;
+	i = rx_ring->next_to_clean;
+	rx_desc = E1000_RX_DESC_EXT(*rx_ring, i);
+	staterr = le32_to_cpu(rx_desc->wb.upper.status_error);
+	buffer_info = &rx_ring->buffer_info[i];
+
+	while (staterr & E1000_RXD_STAT_DD) {
+		struct sk_buff *skb;
+		u8 *va ;
+
+		if (*work_done >= work_to_do)
+			break;
+		(*work_done)++;
+		dma_rmb();	/* read descriptor and rx_buffer_info after status DD */
+
+		i++;
+		if (i == rx_ring->count)
+			i = 0;
+		next_rxd = E1000_RX_DESC_EXT(*rx_ring, i);
+		prefetch(next_rxd);
+
+		next_buffer = &rx_ring->buffer_info[i];
+
+		cleaned = true;
+		cleaned_count++;
+
+		length = le16_to_cpu(rx_desc->wb.upper.length);
+		va = page_address( buffer_info->page ) + buffer_info->page_offset ;
+		dma_sync_single_range_for_cpu( pci_dev_to_dev(pdev), buffer_info->dma,
+					       buffer_info->page_offset, length, DMA_FROM_DEVICE ) ;
+		prefetch( va ) ;
+
+		/* a frame spanning descriptors is tossed, up to and including
+		 * the one with EOP, as in e1000_clean_rx_irq
+		 */
+		if (unlikely(!(staterr & E1000_RXD_STAT_EOP)))
+			adapter->flags2 |= FLAG2_IS_DISCARDING;
+
+		if (adapter->flags2 & FLAG2_IS_DISCARDING) {
+			e_dbg("Receive packet consumed multiple buffers\n");
+			if (staterr & E1000_RXD_STAT_EOP)
+				adapter->flags2 &= ~FLAG2_IS_DISCARDING;
+			goto next_desc;
+		}
+
+		if (unlikely((staterr & E1000_RXDEXT_ERR_FRAME_ERR_MASK) &&
+			     !(netdev->features & NETIF_F_RXALL)))
+			goto next_desc;
+
+		/* adjust length to remove Ethernet CRC */
+		if (!(adapter->flags2 & FLAG2_CRC_STRIPPING)) {
+			if (netdev->features & NETIF_F_RXFCS)
+				total_rx_bytes -= 4;
+			else
+				length -= 4;
+		}
+
+		total_rx_bytes += length;
+		total_rx_packets++;
+
+		if( !entl_rx_frame_wanted( dev, va, length ) ) goto next_desc;
+		if( dev->hwts_on ) entl_hwts_rx( adapter, staterr ) ;
+		if( !entl_device_process_rx( dev, va, length ) ) {
+			// message only, the buffer goes back to the ring untouched
+			ENTL_STAT_INC( dev, rx_tokens_in_place ) ;
+			goto next_desc;
+		}
+		// a token frame without the message only bit, nothing to deliver
+		if( ((const struct ethhdr *)va)->h_proto == 0 ) goto next_desc;
+
+		// copybreak frames get an skb of their own size, the others one for the headers
+		skb = napi_alloc_skb( &adapter->napi, length < dev->copybreak ? length : ENTL_RX_HDR_LEN ) ;
+		if( unlikely(!skb) ) {
+			adapter->alloc_rx_buff_failed++;
+			goto next_desc;
+		}
+		if( length <= ENTL_RX_HDR_LEN || length < dev->copybreak ) {
+			// copied, the half page stays where it is
+			memcpy( __skb_put( skb, length ), va, length ) ;
+			if( length < dev->copybreak ) {
+				ENTL_STAT_INC( dev, rx_copybreak ) ;
+				WRITE_ONCE( dev->stats.rx_copybreak_bytes, dev->stats.rx_copybreak_bytes + length ) ;
+			}
+		}
+		else {
+			memcpy( __skb_put( skb, ENTL_RX_HDR_LEN ), va, ENTL_RX_HDR_LEN ) ;
+			skb_add_rx_frag( skb, 0, buffer_info->page, buffer_info->page_offset + ENTL_RX_HDR_LEN,
+					 length - ENTL_RX_HDR_LEN, ENTL_RX_BUFSZ ) ;
+			entl_rx_page_release( adapter, buffer_info ) ;
+		}
+
+		/* Receive Checksum Offload */
+		e1000_rx_checksum(adapter, staterr, skb);
+
+#ifdef NETIF_F_RXHASH
+		e1000_rx_hash(netdev, rx_desc->wb.lower.hi_dword.rss, skb);
+
+#endif
+		// the hook gets the untagged frames, the tag stripped by the MAC would be lost on the way
+		if( hook && !(staterr & E1000_RXD_STAT_VP) ) {
+#ifdef HAVE_HW_TIME_STAMP
+			e1000e_rx_hwtstamp(adapter, staterr, skb);
+#endif
+			skb->dev = netdev ;
+			__skb_queue_tail( &batch, skb ) ;
+		}
+		else e1000_receive_skb(adapter, netdev, skb, staterr,
+				  rx_desc->wb.upper.vlan);
+
+next_desc:
+		rx_desc->wb.upper.status_error &= cpu_to_le32(~0xFF);
+
+		/* return some buffers to hardware, one at a time is too slow */
+		if (cleaned_count >= E1000_RX_BUFFER_WRITE) {
+			adapter->alloc_rx_buf(rx_ring, cleaned_count,
+					      GFP_ATOMIC);
+			cleaned_count = 0;
+		}
+
+		/* use prefetched values */
+		rx_desc = next_rxd;
+		buffer_info = next_buffer;
+
+		staterr = le32_to_cpu(rx_desc->wb.upper.status_error);
+	}
+	rx_ring->next_to_clean = i;
+
+	cleaned_count = e1000_desc_unused(rx_ring);
+	if (cleaned_count)
+		adapter->alloc_rx_buf(rx_ring, cleaned_count, GFP_ATOMIC);
+
+	// the rx ring is refilled first, the forwarding may take a while
+	if( !skb_queue_empty( &batch ) ) entl_rx_hook_run( adapter, hook, &batch ) ;
+
+#ifdef DYNAMIC_LTR_SUPPORT
+	e1000e_check_ltr_demote(adapter, total_rx_bytes);
+#endif /* DYNAMIC_LTR_SUPPORT */
+	adapter->total_rx_bytes += total_rx_bytes;
+	adapter->total_rx_packets += total_rx_packets;
+#ifdef HAVE_NDO_GET_STATS64
+#elif defined(HAVE_NETDEV_STATS_IN_NETDEV)
+	netdev->stats.rx_bytes += total_rx_bytes;
+	netdev->stats.rx_packets += total_rx_packets;
+#else
+	adapter->net_stats.rx_bytes += total_rx_bytes;
+	adapter->net_stats.rx_packets += total_rx_packets;
+#endif
+	return cleaned;
+}
+#endif
+
 /**
  * entl_e1000_configure_rx - ENTL version of Configure Receive Unit after Reset
  * @adapter: board private structure
@@ -875,6 +1762,12 @@ static void entl_e1000_configure_rx(struct e1000_adapter *adapter)
 		adapter->clean_rx = e1000_clean_jumbo_rx_irq;
 		adapter->alloc_rx_buf = e1000_alloc_jumbo_rx_buffers;
 		ENTL_DEBUG("entl_e1000_configure_rx use e1000_alloc_jumbo_rx_buffers\n" );
+	} else if (adapter->rx_buffer_len <= ENTL_RX_BUFSZ) {
+		// tokens are consumed in place, only the delivered frames get an skb
+		rdlen = rx_ring->count * sizeof(union e1000_rx_desc_extended);
+		adapter->clean_rx = entl_clean_rx_irq;
+		adapter->alloc_rx_buf = entl_alloc_rx_buffers;
+		ENTL_DEBUG("entl_e1000_configure_rx use entl_alloc_rx_buffers\n" );
 #endif
 	} else {
 		rdlen = rx_ring->count * sizeof(union e1000_rx_desc_extended);
@@ -1021,6 +1914,7 @@ static void entl_e1000_configure(struct e1000_adapter *adapter)
 
 	// We don’t need immediate interrupt on Tx completion. (unless buffer was full and quick responce is required, but it’s not likely)
 	e1000_configure_tx(adapter);
+	entl_token_ring_configure(adapter);
 
 #ifdef NETIF_F_RXHASH
 	if (adapter->netdev->features & NETIF_F_RXHASH)
@@ -1032,96 +1926,325 @@ static void entl_e1000_configure(struct e1000_adapter *adapter)
 	entl_e1000_configure_rx(adapter);
 	adapter->alloc_rx_buf(rx_ring, e1000_desc_unused(rx_ring), GFP_KERNEL);
 
+	// start from the low latency end of the interrupt moderation
+	dev->itr_delay_ns = 0 ;
+	dev->itr_radv = 0 ;
+	dev->token_interval_ns = 0 ;
+
 	// initialize the state machine
-	entl_state_machine_init( &dev->stm ) ;
-	strlcpy(dev->stm.name, dev->name, sizeof(dev->stm.name));
+	entl_link_reset( &dev->link ) ;
 	
 	// AK: Setting MAC address for Hello handling
 	entl_e1000_set_my_addr( &adapter->entl_dev, netdev->dev_addr ) ;
 
+	// hardware timestamps of the token exchange
+	entl_hwts_start( adapter ) ;
+
+	// pm_qos, EEE and ASPM part of the low-latency profile, the irq is pinned when it is requested
+	entl_lowlat_apply( adapter ) ;
+
+	// opt-in busy poll of the rx ring for the token exchange
+	entl_busy_poll_start( adapter ) ;
+
 	// force to check the link status on kernel task
 	hw->mac.get_link_status = true;
 }
 
 static void entl_e1000_set_my_addr( entl_device_t *dev, const u8 *addr ) 
 {
-	u16 u_addr;
-	u32 l_addr;
+	entl_link_set_addr( &dev->link, addr ) ;
+}
 
-	ENTL_DEBUG("entl_e1000_set_my_addr set %d.%d.%d.%d.%d.%d\n", addr[0], addr[1], addr[2], addr[3], addr[4], addr[5] );
+// process context, the queue must be empty and stopped. The slots are reallocated only when the
+//   tx ring size changed, and the old ones are kept if that fails
+static void init_ENTL_skb_queue( ENTL_skb_queue_t* q, int slots ) 
+{
+    struct sk_buff **data ;
 
-		
-    u_addr = (u16)addr[0] << 8 | addr[1] ;
-    l_addr = (u32)addr[2] << 24 | (u32)addr[3] << 16 | (u32)addr[4] << 8 | (u32)addr[5] ;
-    entl_set_my_adder( &dev->stm, u_addr, l_addr ) ;
+    if( slots > ENTL_SKB_QUEUE_MAX ) slots = ENTL_SKB_QUEUE_MAX ;
+    if( slots < 2 ) slots = 2 ;
+    slots = rounddown_pow_of_two( slots ) ;
+    q->head = q->tail = 0 ;
+    if( q->data && q->size == slots ) return ;
 
+    data = kvmalloc_array( slots, sizeof(struct sk_buff *), GFP_KERNEL ) ;
+    if( !data ) {
+    	ENTL_DEBUG("init_ENTL_skb_queue failed to allocate %d slots, keeping %d\n", slots, q->size ) ;
+    	return ;
+    }
+    kvfree( q->data ) ;
+    q->data = data ;
+    q->size = slots ;
+    q->mask = slots - 1 ;
 }
 
-static void init_ENTL_skb_queue( ENTL_skb_queue_t* q ) 
+static void free_ENTL_skb_queue( ENTL_skb_queue_t* q ) 
 {
-    q->size = E1000_DEFAULT_TXD ;
-    q->count = 0 ;
+    kvfree( q->data ) ;
+    q->data = NULL ;
+    q->size = q->mask = 0 ;
     q->head = q->tail = 0 ;
 }
 
 static int ENTL_skb_queue_full( ENTL_skb_queue_t* q ) 
 {
-    if( q->size == q->count ) return 1 ;
-    return 0 ;
+    // producer side
+    return q->tail - smp_load_acquire( &q->head ) >= q->size ;
 }
 
 static int ENTL_skb_queue_has_data( ENTL_skb_queue_t* q ) 
 {
-    return q->count ;
+    // consumer side, returns number of queued skbs
+    return smp_load_acquire( &q->tail ) - q->head ;
 }
 
 static int ENTL_skb_queue_unused( ENTL_skb_queue_t* q ) 
 {
-    return q->size - q->count - 1 ;
+    return q->size - ( READ_ONCE(q->tail) - READ_ONCE(q->head) ) ;
 }
 
 static int push_back_ENTL_skb_queue(ENTL_skb_queue_t* q, struct sk_buff *dt ) 
 {
-    if( q->size == q->count ) {
+    u32 tail = q->tail ;
+    if( tail - smp_load_acquire( &q->head ) >= q->size ) {
     	// queue full
     	return -1 ;
     }
-    q->data[q->tail] = dt ;
-    q->tail = (q->tail+1) % q->size ;
-    q->count++ ;
-    return q->size - q->count ;
+    q->data[tail & q->mask] = dt ;
+    // the slot must be visible before the consumer sees the new tail
+    smp_store_release( &q->tail, tail + 1 ) ;
+    return q->size - ( tail + 1 - READ_ONCE(q->head) ) ;
 }
 
 static struct sk_buff *front_ENTL_skb_queue(ENTL_skb_queue_t* q ) 
 {
-	struct sk_buff *dt ;
-	if( q->count == 0 ) return NULL ; // queue empty
-	dt = q->data[q->head] ;
-    return dt ;
+    if( smp_load_acquire( &q->tail ) == q->head ) return NULL ; // queue empty
+    return q->data[q->head & q->mask] ;
 }
 
 static struct sk_buff *pop_front_ENTL_skb_queue(ENTL_skb_queue_t* q ) 
 {
 	struct sk_buff *dt ;
-	if( q->count == 0 ) return NULL ; // queue empty
-	dt = q->data[q->head] ;
-    q->head = (q->head+1) % q->size ;
-    q->count-- ;
+	u32 head = q->head ;
+	if( smp_load_acquire( &q->tail ) == head ) return NULL ; // queue empty
+	dt = q->data[head & q->mask] ;
+	// the slot is read before the producer may reuse it
+	smp_store_release( &q->head, head + 1 ) ;
     return dt ;
 }
 
+/// tx class of a data frame, by EtherType first and then by skb->priority as pfifo_fast does
+static int entl_tx_class( struct sk_buff *skb, struct ethhdr *eth )
+{
+	u32 prio = skb->priority & TC_PRIO_MAX ;
+
+	if( eth->h_proto == ETH_P_ECLD || prio >= TC_PRIO_INTERACTIVE ) return ENTL_TX_CLASS_CONTROL ;
+	if( prio == TC_PRIO_BULK || prio == TC_PRIO_FILLER ) return ENTL_TX_CLASS_BULK ;
+	return ENTL_TX_CLASS_NORMAL ;
+}
+
+/// producer side, the queue of the class must have room
+static void entl_tx_enqueue( entl_device_t *dev, int cls, struct sk_buff *skb )
+{
+	ENTL_skb_queue_t *q = &dev->tx_skb_queue[cls] ;
+	u32 depth ;
+
+	ENTL_TX_CB(skb)->enqueued = ktime_get() ;
+	ENTL_TX_CB(skb)->bypass = 0 ;
+	// the consumer owns the skb once it is in the queue
+	push_back_ENTL_skb_queue( q, skb ) ;
+	depth = q->tail - READ_ONCE(q->head) ;
+	if( depth > dev->stats.tx_class[cls].max_depth ) WRITE_ONCE( dev->stats.tx_class[cls].max_depth, depth ) ;
+}
+
+/// consumer side, the next data frame in priority order, NULL when all classes are empty
+static struct sk_buff *entl_tx_peek( entl_device_t *dev, int *cls )
+{
+	struct sk_buff *dt ;
+	int i ;
+
+	for( i = 0 ; i < ENTL_TX_CLASSES ; i++ ) {
+		if( NULL != (dt = front_ENTL_skb_queue( &dev->tx_skb_queue[i] )) ) {
+			*cls = i ;
+			return dt ;
+		}
+	}
+	return NULL ;
+}
+
+/// take the frame entl_tx_peek returned off its queue and count the time it waited
+static void entl_tx_pop( entl_device_t *dev, int cls )
+{
+	entl_tx_class_stats_t *st = &dev->stats.tx_class[cls] ;
+	struct sk_buff *dt = pop_front_ENTL_skb_queue( &dev->tx_skb_queue[cls] ) ;
+	u64 wait = ktime_to_ns( ktime_sub( ktime_get(), ENTL_TX_CB(dt)->enqueued ) ) ;
+
+	WRITE_ONCE( st->frames, st->frames + 1 ) ;
+	WRITE_ONCE( st->wait_ns, st->wait_ns + wait ) ;
+	if( wait > st->max_wait_ns ) WRITE_ONCE( st->max_wait_ns, wait ) ;
+}
+
+static int entl_tx_queue_has_data( entl_device_t *dev )
+{
+	int i, n = 0 ;
+
+	for( i = 0 ; i < ENTL_TX_CLASSES ; i++ ) n += ENTL_skb_queue_has_data( &dev->tx_skb_queue[i] ) ;
+	return n ;
+}
+
+/// free slots of the fullest class, the netif queue is woken when every class has room again
+static int entl_tx_queue_room( entl_device_t *dev )
+{
+	int i, room = ENTL_SKB_QUEUE_MAX ;
+
+	for( i = 0 ; i < ENTL_TX_CLASSES ; i++ ) room = min( room, ENTL_skb_queue_unused( &dev->tx_skb_queue[i] ) ) ;
+	return room ;
+}
+
+static void entl_tx_class_depth( entl_device_t *dev )
+{
+	int i ;
+
+	for( i = 0 ; i < ENTL_TX_CLASSES ; i++ ) {
+		ENTL_skb_queue_t *q = &dev->tx_skb_queue[i] ;
+		dev->stats.tx_class[i].depth = READ_ONCE(q->tail) - READ_ONCE(q->head) ;
+	}
+}
+
+static void entl_cycles_update( entl_device_t *dev )
+{
+	int i ;
+
+	for( i = 0 ; i < ENTL_CYCLES_CLASSES ; i++ ) {
+		entl_cycles_stats_t *c = &dev->stats.cycles[i] ;
+		u64 events = READ_ONCE( c->events ) ;
+		c->per_event = events ? div64_u64( READ_ONCE( c->cycles ), events ) : 0 ;
+	}
+}
+
+static void entl_tx_queue_reset( entl_device_t *dev, int slots )
+{
+	struct sk_buff *dt ;
+	int i ;
+
+	// BQL is reset together with the tx ring, so these are just freed
+	for( i = 0 ; i < ENTL_TX_CLASSES ; i++ ) {
+		while( NULL != (dt = pop_front_ENTL_skb_queue( &dev->tx_skb_queue[i] )) ) {
+			dev_kfree_skb_any( dt ) ;
+		}
+		init_ENTL_skb_queue( &dev->tx_skb_queue[i], slots ) ;
+	}
+}
+
+/// segment a GSO skb in software and queue the segments, returns 1 if the queue has no room for them
+static int entl_tx_queue_gso( entl_device_t *dev, int cls, struct sk_buff *skb, struct net_device *netdev )
+{
+	ENTL_skb_queue_t *q = &dev->tx_skb_queue[cls] ;
+	struct sk_buff *segs, *next ;
+	int nsegs = skb_shinfo(skb)->gso_segs ;
+
+	if( nsegs > q->size ) {
+		ENTL_DEBUG("%s entl_tx_queue_gso dropping %d segments\n", netdev->name, nsegs ) ;
+		dev_kfree_skb_any(skb);
+		return 0 ;
+	}
+	if( ENTL_skb_queue_unused( q ) < nsegs ) {
+		ENTL_STAT_INC( dev, tx_queue_stops ) ;
+		netif_stop_queue(netdev);
+		// the consumer may have drained the queue before it could see the stop
+		smp_mb() ;
+		if( ENTL_skb_queue_unused( q ) < nsegs ) return 1 ;
+		netif_start_queue(netdev);
+	}
+
+	// keep the checksum offload, only the segmentation is done here
+	segs = skb_gso_segment( skb, netdev->features & ~NETIF_F_GSO_MASK ) ;
+	if( IS_ERR_OR_NULL(segs) ) {
+		ENTL_DEBUG("%s entl_tx_queue_gso skb_gso_segment failed\n", netdev->name ) ;
+		dev_kfree_skb_any(skb);
+		return 0 ;
+	}
+	dev_consume_skb_any(skb);
+
+	for( ; segs ; segs = next ) {
+		next = segs->next ;
+		segs->next = NULL ;
+		if( skb_put_padto(segs, 17) ) continue ;
+		netdev_sent_queue( netdev, segs->len ) ;
+		if( ENTL_skb_queue_full( q ) ) {
+			// gso_segs was short of the real count
+			netdev_completed_queue( netdev, 1, segs->len ) ;
+			dev_kfree_skb_any(segs);
+			continue ;
+		}
+		entl_tx_enqueue( dev, cls, segs ) ;
+	}
+	return 0 ;
+}
+
+/// the frames which don't need the ENTL ordering, by EtherType or by the bit of skb->priority.
+///   The priority picks among the ECLP/ECLD frames only, the peer drops any other EtherType
+static bool entl_tx_is_bypass( entl_device_t *dev, struct sk_buff *skb, struct ethhdr *eth )
+{
+	if( dev->bypass_type && eth->h_proto == htons( dev->bypass_type ) ) return true ;
+	if( eth->h_proto != ETH_P_ECLP && eth->h_proto != ETH_P_ECLD ) return false ;
+	return dev->bypass_prio & (1u << (skb->priority & TC_PRIO_MAX)) ;
+}
+
+// room on the tx ring for the largest skb, as e1000_xmit_frame counts it, above the descriptors kept
+// for the tokens and the gated burst the next token releases
+static bool entl_tx_bypass_room( struct e1000_adapter *adapter, entl_device_t *dev )
+{
+	struct e1000_ring *tx_ring = adapter->tx_ring ;
+	int need = MAX_SKB_FRAGS * DIV_ROUND_UP(PAGE_SIZE, adapter->tx_fifo_limit) + 2 ;
+	int reserve = min_t( int, ENTL_TX_BYPASS_RESERVE + 3 * dev->burst_frames, tx_ring->count / 2 ) ;
+
+	return e1000_desc_unused( tx_ring ) >= need + reserve ;
+}
+
+/// send a bypass frame on the tx ring now, next to the gated frames and the tokens which go on by themselves.
+///   It keeps TSO, as it needs no token per frame
+static netdev_tx_t entl_tx_bypass_xmit( entl_device_t *dev, int cls, struct sk_buff *skb, struct net_device *netdev )
+{
+	struct e1000_adapter *adapter = container_of( dev, struct e1000_adapter, entl_dev );
+	entl_tx_class_stats_t *st = &dev->stats.tx_class[cls] ;
+
+	if( !entl_tx_bypass_room( adapter, dev ) ) {
+		// woken by the tx ring cleanup
+		ENTL_STAT_INC( dev, tx_bypass_busy ) ;
+		netif_stop_queue(netdev);
+		// the cleanup may have freed the ring before it could see the stop
+		smp_mb() ;
+		if( !entl_tx_bypass_room( adapter, dev ) ) return NETDEV_TX_BUSY;
+		netif_start_queue(netdev);
+	}
+
+	// pad here so the bytes charged to BQL match the bytes completed by the tx ring cleanup
+	if( skb_put_padto(skb, 17) ) return NETDEV_TX_OK;
+	entl_tx_set_nop( (struct ethhdr *)skb->data ) ;
+	ENTL_TX_CB(skb)->bypass = 1 ;
+	WRITE_ONCE( st->bypass_frames, st->bypass_frames + 1 ) ;
+	WRITE_ONCE( st->bypass_bytes, st->bypass_bytes + skb->len ) ;
+
+	// e1000_xmit_frame does not charge BQL when TX_ON_ENTL_ENABLE
+	netdev_sent_queue( netdev, skb->len ) ;
+	return e1000_xmit_frame( skb, netdev ) ;
+}
+
 /// tx queue handling, replacing e1000_xmit_frame
 static netdev_tx_t entl_tx_transmit( struct sk_buff *skb, struct net_device *netdev ) 
 {
 	struct e1000_adapter *adapter = netdev_priv(netdev);
 	entl_device_t *dev = &adapter->entl_dev ;
 	struct ethhdr *eth = (struct ethhdr *)skb->data ;
+	ENTL_skb_queue_t *q ;
+	int cls ;
+
+	// ports with EntlMode off are plain e1000e
+	if( !entl_port( adapter ) ) return e1000_xmit_frame( skb, netdev ) ;
+
+	if( entl_tx_is_bypass( dev, skb, eth ) ) return entl_tx_bypass_xmit( dev, entl_tx_class( skb, eth ), skb, netdev ) ;
 
-	if( ENTL_skb_queue_full( &dev->tx_skb_queue ) ) {
-		ENTL_DEBUG("entl_tx_transmit Queue full!! %d %d\n", dev->tx_skb_queue.count,  dev->tx_skb_queue.size ) ;
-		BUG_ON( dev->tx_skb_queue.count >= dev->tx_skb_queue.size) ;
-		return NETDEV_TX_BUSY;
-	}
 	if( eth->h_proto != ETH_P_ECLP && eth->h_proto != ETH_P_ECLD ) {
 		ENTL_DEBUG("%s entl_tx_transmit dropping non EC type %4x %p len %d d: %02x %02x %02x %02x %02x %02x  %02x %02x %02x %02x %02x %02x  %02x%02x %02x %02x %02x %02x %02x %02x\n", netdev->name, eth->h_proto, skb, skb->len,
 		  skb->data[0], skb->data[1], skb->data[2], skb->data[3], skb->data[4], skb->data[5], 
@@ -1132,21 +2255,50 @@ static netdev_tx_t entl_tx_transmit( struct sk_buff *skb, struct net_device *net
 		dev_kfree_skb_any(skb);
 		return NETDEV_TX_OK;
 	}
+	cls = entl_tx_class( skb, eth ) ;
+	q = &dev->tx_skb_queue[cls] ;
+	if( ENTL_skb_queue_full( q ) ) {
+		// the queue can be woken by the tx ring cleanup, so just stop it again
+		ENTL_DEBUG("entl_tx_transmit Queue full!! class %d %d\n", cls, q->size ) ;
+		ENTL_STAT_INC( dev, tx_queue_stops ) ;
+		netif_stop_queue(netdev);
+		// the consumer may have drained the queue before it could see the stop
+		smp_mb() ;
+		if( ENTL_skb_queue_full( q ) ) return NETDEV_TX_BUSY;
+		netif_start_queue(netdev);
+	}
 
-	push_back_ENTL_skb_queue( &dev->tx_skb_queue, skb ) ;
+	if( skb_is_gso(skb) ) {
+		// a GSO skb can't carry a token per frame, so queue the segments instead
+		if( entl_tx_queue_gso( dev, cls, skb, netdev ) ) return NETDEV_TX_BUSY;
+	}
+	else {
+		// pad here so the bytes charged to BQL match the bytes completed by the tx ring cleanup
+		if( skb_put_padto(skb, 17) ) return NETDEV_TX_OK;
 
-	ENTL_DEBUG("%s entl_tx_transmit got packet %p len %d count %d head %d tail %d d: %02x %02x %02x %02x %02x %02x  %02x %02x %02x %02x %02x %02x  %02x%02x %02x %02x %02x %02x %02x %02x\n", netdev->name, skb, skb->len, dev->tx_skb_queue.count, dev->tx_skb_queue.head, dev->tx_skb_queue.tail,
-	  skb->data[0], skb->data[1], skb->data[2], skb->data[3], skb->data[4], skb->data[5], 
-	  skb->data[6], skb->data[7], skb->data[8], skb->data[9], skb->data[10], skb->data[11], 
-	  skb->data[12], skb->data[13],
-	  skb->data[14], skb->data[15], skb->data[16], skb->data[17], skb->data[18], skb->data[19]
-	  ) ;
+		// BQL covers the time in this queue, e1000_xmit_frame does not charge these again
+		netdev_sent_queue( netdev, skb->len ) ;
 
-	if( ENTL_skb_queue_unused( &dev->tx_skb_queue ) < 2 ) {
-		ENTL_DEBUG("entl_tx_transmit Queue near full, flow control %d %d\n", dev->tx_skb_queue.count,  dev->tx_skb_queue.size ) ;
+		ENTL_DEBUG("%s entl_tx_transmit got packet %p len %d class %d count %d head %d tail %d d: %02x %02x %02x %02x %02x %02x  %02x %02x %02x %02x %02x %02x  %02x%02x %02x %02x %02x %02x %02x %02x\n", netdev->name, skb, skb->len, cls, q->tail - READ_ONCE(q->head), q->head, q->tail,
+		  skb->data[0], skb->data[1], skb->data[2], skb->data[3], skb->data[4], skb->data[5], 
+		  skb->data[6], skb->data[7], skb->data[8], skb->data[9], skb->data[10], skb->data[11], 
+		  skb->data[12], skb->data[13],
+		  skb->data[14], skb->data[15], skb->data[16], skb->data[17], skb->data[18], skb->data[19]
+		  ) ;
+
+		entl_tx_enqueue( dev, cls, skb ) ;
+	}
+
+	// one netif queue feeds all classes, so it stops when any class fills up
+	if( ENTL_skb_queue_full( q ) ) {
+		ENTL_DEBUG("entl_tx_transmit Queue full, flow control class %d %d\n", cls, q->size ) ;
+		ENTL_STAT_INC( dev, tx_queue_stops ) ;
 		netif_stop_queue(netdev);
-		dev->queue_stopped = 1 ;
-		return NETDEV_TX_BUSY;		
+		// the consumer may have drained the queue before it could see the stop
+		smp_mb() ;
+		if( entl_tx_queue_room( dev ) >= ENTL_TX_WAKE_THRESHOLD ) {
+			netif_start_queue(netdev);
+		}
 	}
 	return NETDEV_TX_OK;
 
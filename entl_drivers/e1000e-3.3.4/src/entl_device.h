@@ -9,57 +9,278 @@
 #define _ENTL_DEVICE_H_
 
  #include "entl_state_machine.h"
+ #include "entl_ait_ring.h"
+ #include "entl_link.h"
+ #include "entl_placement.h"
+ #include <linux/kthread.h>
+ #include <linux/pkt_sched.h>
+ #include <linux/jump_label.h>
+ #include <asm/unaligned.h>
+ #include <linux/timex.h>
 
-// these flags are used to request tasks to service task
-#define ENTL_DEVICE_FLAG_HELLO 		1
-#define ENTL_DEVICE_FLAG_SIGNAL 	2
-#define ENTL_DEVICE_FLAG_RETRY 		4
-#define ENTL_DEVICE_FLAG_WAITING 	8
-#define ENTL_DEVICE_FLAG_SIGNAL2	0x10
+ #define ENTL_DEFAULT_TXD   256
 
-#define ENTL_DEVICE_FLAG_FATAL 0x8000
 
- #define ENTL_DEFAULT_TXD   256
+// the tx queue never needs more slots than the tx ring has descriptors, it is sized to the ring
+#define ENTL_SKB_QUEUE_MAX 4096    // E1000_MAX_TXD, which is defined after this header is included
+
+// interrupt moderation: data frames per token above which data dominates, and the longest delay to add
+#define ENTL_ITR_DATA_PER_TOKEN 4
+#define ENTL_ITR_MAX_DELAY_NS 100000
+
+// busy poll: rx descriptors per round, idle time before going back to interrupts,
+// and how long to wait for the interrupt path to release the NAPI context
+#define ENTL_BUSY_POLL_BUDGET 64
+#define ENTL_BUSY_POLL_IDLE_USEC 1000
+#define ENTL_BUSY_POLL_CLAIM_TRIES 10000
+
+// pm_qos cpu latency requested by the low-latency profile
+#define ENTL_LOWLAT_CPU_LATENCY_USEC 0
+
+// hardware timestamps: tokens without AIT carry the sender turnaround time behind this marker
+#define ENTL_HWTS_MAGIC 0x45485453
+
+// token queue: descriptors of the second tx ring, and the queue enable bit of TARC on the 82574
+#define ENTL_TOKEN_RING_COUNT 64
+#define ENTL_TARC_ENABLE (1 << 10)
+
+// page recycling rx: each descriptor owns half a page, mapped once, and the halves flip when a frame goes up.
+//   Frames under the copybreak get a right-sized copy, the others up to ENTL_RX_HDR_LEN are copied to a
+//   header sized skb, and the rest of a longer frame is attached as a page frag
+#define ENTL_RX_BUFSZ 2048
+#define ENTL_RX_HDR_LEN 256
 
+// wake the netif queue when this many slots are free again
+#define ENTL_TX_WAKE_THRESHOLD 32
 
+// strict-priority classes of the tx queue, a token takes its data from the lowest non-empty class first
+#define ENTL_TX_CLASS_CONTROL 0    // ETH_P_ECLD, and skb->priority TC_PRIO_INTERACTIVE or TC_PRIO_CONTROL
+#define ENTL_TX_CLASS_NORMAL 1
+#define ENTL_TX_CLASS_BULK 2       // skb->priority TC_PRIO_BULK or TC_PRIO_FILLER
+#define ENTL_TX_CLASSES 3
+
+// single producer (entl_tx_transmit) / single consumer (rx processing) ring
+//   head/tail are free running, the slot is (index & mask). Each side writes only its own index
+//   and publishes it with release, the other side reads it with acquire.
 typedef struct ENTL_skb_queue {
-    u16 size ;
-    u16 count ;
-    u16 head ;
-    u16 tail ;
-    struct sk_buff *data[ENTL_DEFAULT_TXD] ;
+    u32 size ;                                  // power of 2, <= ENTL_SKB_QUEUE_MAX, 0 until data is allocated
+    u32 mask ;
+    u32 head ____cacheline_aligned_in_smp ;     // written by the consumer
+    u32 tail ____cacheline_aligned_in_smp ;     // written by the producer
+    struct sk_buff **data ;                     // size slots, allocated by init_ENTL_skb_queue
 } ENTL_skb_queue_t ;
 
-typedef struct entl_device {
-	entl_state_machine_t stm ;              /// the state machine structure
+// kept in skb->cb from entl_tx_transmit to e1000_xmit_frame
+typedef struct entl_tx_cb {
+    ktime_t enqueued ;              // when a gated frame entered its tx queue
+    u8 bypass ;                     // sent without a token, see entl_tx_bypass_xmit
+} entl_tx_cb_t ;
+
+// tx ring descriptors the bypass frames leave free for the token and the gated data burst,
+//   3 per burst frame on top of this, capped at half of the ring
+#define ENTL_TX_BYPASS_RESERVE 16
+
+#define ENTL_TX_CB(skb) ((entl_tx_cb_t *)(skb)->cb)
 
-	struct timer_list watchdog_timer;      /// watchdog time for this device
-	struct work_struct watchdog_task;      /// kernel process task for non-interrupt processes
-	
-	int user_pid;                          /// user process id to send the signal
+// per tx class counters, depth is refreshed by e1000e_update_stats, max_depth and the bypass counters
+// are written by entl_tx_transmit, the rest by the rx path which sends the gated frames
+typedef struct entl_tx_class_stats {
+    u64 frames ;                    // data frames sent from the class on a token
+    u64 wait_ns ;                   // total time they waited for a token, wait_ns / frames is the mean
+    u64 max_wait_ns ;
+    u64 depth ;                     // frames in the queue
+    u64 max_depth ;
+    u64 bypass_frames ;             // frames of the class sent without a token, by EntlBypassType or EntlBypassPrio
+    u64 bypass_bytes ;
+} entl_tx_class_stats_t ;
 
-	// flag is used to set a request to the service task
-	__u32 flag ;
+// cpu cycles of the ENTL hot paths, counted while the entl_cycles module parameter is set
+//   TOKEN, AIT and RX_DATA split entl_device_process_rx by the frame: a message only token, a token exchange
+//   which received or sent an AIT, and a data frame. The first two include the reply and the data burst
+//   the token releases. TX_DATA is entl_device_process_tx_packet, once per gated data frame.
+//   INJECT is inject_message from any caller, so it overlaps the others, and WATCHDOG the watchdog task
+#define ENTL_CYCLES_TOKEN     0
+#define ENTL_CYCLES_AIT       1
+#define ENTL_CYCLES_RX_DATA   2
+#define ENTL_CYCLES_TX_DATA   3
+#define ENTL_CYCLES_INJECT    4
+#define ENTL_CYCLES_WATCHDOG  5
+#define ENTL_CYCLES_CLASSES   6
 
-	// keep the last value to be sent for retry
-    __u16 u_addr; 
-    __u32 l_addr;	
-    int action ;
+// written by the path that runs the code: the rx path for TOKEN to TX_DATA (the gated data frames are sent
+// from the rx path), the tx_ring_lock holder for INJECT and the watchdog task for WATCHDOG.
+// per_event is refreshed by e1000e_update_stats
+typedef struct entl_cycles_stats {
+    u64 cycles ;
+    u64 events ;
+    u64 per_event ;                 // cycles / events
+} entl_cycles_stats_t ;
+
+// per-port counters reported by ethtool -S, with the link counters in entl_link_stats_t
+//   each counter has a single writer (tx_ring_lock holder, the rx path or the tx path),
+//   so it is bumped with a plain store and read without a lock
+typedef struct entl_stats {
+    u64 tokens_sent ;               // ENTL messages injected by the driver
+    u64 ait_sent ;
+    u64 inject_busy ;               // inject_message failed, adapter down or tx ring full
+    u64 inject_nomem ;              // inject_message failed to allocate the skb
+    u64 inject_dma_err ;            // inject_message failed to map the skb
+    u64 tx_queue_stops ;            // entl_tx_transmit stopped the netif queue
+    u64 tx_bypass_busy ;            // a bypass frame found the tx ring down to the reserve, the netif queue stopped
+    u64 rx_tokens_in_place ;        // message only frames consumed from the rx buffer, no skb and no DMA mapping
+    u64 rx_page_reuse ;             // delivered frames whose rx page went back to the ring
+    u64 rx_page_alloc ;             // rx pages allocated and mapped, first fill or the stack still held the other half
+    u64 rx_copybreak ;              // data frames copied into a right-sized skb, the rx buffer stayed on the ring
+    u64 rx_copybreak_bytes ;
+    u64 rx_drop_non_ec ;            // frames neither a token nor ECLP/ECLD, dropped from the rx buffer
+    u64 alo_ops ;                   // ALO operations run for the peer
+    u64 alo_results ;               // ALO results received from the peer
+    u64 rx_hook_batches ;           // NAPI polls which handed data frames to the rx hook
+    u64 rx_hook_frames ;            // data frames handed to the rx hook
+    u64 rx_hook_host ;              // of those, the frames the hook gave back for this host
+    entl_tx_class_stats_t tx_class[ENTL_TX_CLASSES] ;
+    entl_cycles_stats_t cycles[ENTL_CYCLES_CLASSES] ;
+} entl_stats_t ;
+
+/// Direct hand-off of the received data frames to a forwarding module such as ecnl, in place of the host
+///   stack. entl_clean_rx_irq collects the data frames of one NAPI poll, skb->data on the Ethernet header,
+///   and passes them in one call from the NAPI context. The hook owns the frames it takes off batch and
+///   puts the ones for this host on host, which the driver then delivers through GRO
+typedef struct entl_rx_hook {
+	void (*receive)( struct entl_rx_hook *hook, struct sk_buff_head *batch, struct sk_buff_head *host ) ;
+} entl_rx_hook_t ;
+
+typedef struct entl_device {
+	entl_link_t link ;                     /// the state machine, its watchdog and the AIT rings, on entl_link_ops
 
     char name[ENTL_DEVICE_NAME_LEN] ;
 
-  	ENTL_skb_queue_t tx_skb_queue ;
-  	int queue_stopped ;
+  	ENTL_skb_queue_t tx_skb_queue[ENTL_TX_CLASSES] ;   /// data frames waiting for the token, one queue per tx class
+
+  	// data burst credit per received token, set from EntlBurstFrames/EntlBurstBytes
+  	u32 burst_frames ;                     /// max data frames per token, the first one carries the token
+  	u32 burst_bytes ;                      /// max data bytes per token, 0 for no byte limit
+
+  	// ungated data, set from EntlBypassType/EntlBypassPrio. The peer needs the same EtherType to take them
+  	u32 bypass_type ;                      /// EtherType sent without a token, 0 for none
+  	u32 bypass_prio ;                      /// bit n set: skb->priority n is sent without a token
+
+  	// rx copybreak, set from EntlCopybreak
+  	u32 copybreak ;                        /// data frames shorter than this go up in a right-sized copy
+
+  	// interrupt moderation driven by the token interval, see entl_set_itr
+  	ktime_t last_token_time ;
+  	u32 token_interval_ns ;                /// moving average of the time between received tokens
+  	u32 itr_tokens ;                       /// tokens received since the last entl_set_itr
+  	u32 itr_data_frames ;                  /// data frames received since the last entl_set_itr
+  	u32 itr_delay_ns ;                     /// current interrupt delay, 0 for lowest latency
+  	u32 itr_radv ;                         /// RADV value last written
+  	u32 rtt_hist[ENTL_RTT_HIST_BUCKETS] ;  /// histogram of the time between received tokens
+
+  	// busy poll, set from EntlBusyPoll
+  	int busy_poll_cpu ;                    /// cpu to pin the polling thread on, -1 when disabled
+  	struct task_struct *busy_poll_task ;
+  	int busy_poll_kick ;                   /// set by the interrupt path to start a busy poll period
+  	u32 busy_polls ;                       /// number of busy poll periods
+
+  	// low-latency platform profile, set from EntlLowLatency
+  	int lowlat ;                           /// apply the profile on this port
+  	int lowlat_applied ;
+  	int lowlat_irq_pinned ;
+  	int lowlat_eee_changed ;               /// EEE was on and is turned off by the profile
+  	u16 lowlat_aspm ;                      /// ASPM control of the port before the profile
+  	u16 lowlat_parent_aspm ;               /// ASPM control of the upstream port before the profile
+#ifdef HAVE_PM_QOS_REQUEST_LIST_NEW
+  	struct pm_qos_request lowlat_qos ;
+#elif defined(HAVE_PM_QOS_REQUEST_LIST)
+  	struct pm_qos_request_list lowlat_qos ;
+#endif
+
+  	// hardware timestamps of the token exchange, set from EntlHwTstamp
+  	int hwts ;                             /// timestamp tokens in hardware if the MAC can
+  	int hwts_on ;                          /// the MAC is set up for it
+  	int hwts_tx_pending ;                  /// a token went out with a tx timestamp request, protected by tx_ring_lock
+  	u64 hwts_rx_ns ;                       /// rx timestamp of the frame being processed, 0 if it has none
+  	u64 hwts_last_rx_ns ;                  /// rx timestamp of the last token
+  	u32 hwts_turnaround_ns ;               /// last token rx to the reply tx on this side, told to the peer
+  	u32 hw_rtt_ns ;                        /// our token tx to the reply rx, both on the wire
+  	u32 hw_one_way_ns ;                    /// (hw_rtt_ns - the peer turnaround) / 2
+
+  	// second hardware tx queue for the tokens, set from EntlTokenQueue
+  	int token_queue ;                      /// use it if the MAC has one
+  	struct e1000_ring *token_ring ;        /// tokens and AIT frames, NULL when they share the data ring. Protected by tx_ring_lock
+
+  	int port_enable ;                      /// run ENTL on the port, set from EntlMode
+
+  	// ALO registers, run on AIT arrival
+  	spinlock_t alo_lock ;                  /// protects alo_regs, the rx path and the ioctls
+  	entl_alo_regs_t alo_regs ;
+  	entl_alo_result_t alo_reply ;          /// result for the peer, goes out in our Ack. Protected by tx_ring_lock
+  	int alo_reply_pending ;
+  	entl_alo_result_t alo_result ;         /// last result from the peer, protected by alo_lock
+  	entl_alo_result_t alo_last ;           /// result of the last operation run, a resend gets it again. Protected by alo_lock
+
+  	// rx filter, set from EntlRxFilter
+  	int rx_filter ;                        /// MPE and BAM off, the MAC drops group addressed frames
+
+  	// cpu placement, set from EntlPlacement and /sys/class/net/<port>/entl
+  	int placement_on ;                     /// the port is in the placement layout
+  	entl_placement_t placement ;           /// the token core is also link.work_cpu
+
+  	// TDT update batching, both protected by tx_ring_lock
+  	int tx_batch ;                         /// set while the NAPI poll processes the rx ring
+  	int tx_pending ;                       /// descriptors were queued in the batch but TDT is not written yet
+
+  	entl_rx_hook_t __rcu *rx_hook ;        /// data frames go to the hook instead of the stack, see entl_rx_hook_set
+
+  	entl_stats_t stats ;                   /// counters for ethtool -S
 
 } entl_device_t ;
 
+/// attach the rx hook to the port, or detach it with NULL. Process context, detaching waits for the NAPI
+///   poll which may still be in the hook. Called by the forwarding module on the entl_dev of the adapter
+static inline void entl_rx_hook_set( entl_device_t *dev, entl_rx_hook_t *hook )
+{
+	rcu_assign_pointer( dev->rx_hook, hook ) ;
+	if( !hook ) synchronize_net() ;
+}
+
 // entl_device.c is also included in the netdev.c code so all functions are declared static here
 
 #ifdef _IN_NETDEV_C_
 
+// The e1000e code calls into ENTL only behind entl_port(adapter). The static key is on while any port
+//   runs ENTL, so with no ENTL port the hooks are a patched out jump. The hooks are:
+//     probe/remove       entl_device_init, entl_port_enable, entl_port_disable, entl_placement_sysfs, entl_placement_start,
+//                        entl_placement_stop, entl_device_stop
+//     open/close/up/down entl_e1000_configure, entl_tx_queue_reset, entl_token_ring_*, entl_busy_poll_stop, entl_device_link_down
+//     watchdog           entl_device_link_up, entl_device_link_down
+//     irq and itr        entl_lowlat_pin_irq, entl_lowlat_unpin_irq, entl_set_itr
+//     NAPI poll          entl_tx_batch_begin, entl_tx_batch_end
+//     rx                 entl_rx_frame_wanted, entl_device_process_rx, adapter->clean_rx set by entl_e1000_configure_rx,
+//                        and entl_rx_hook_run from it
+//     tx                 entl_tx_transmit, entl_device_process_tx_packet, tx_ring_lock in e1000_xmit_frame
+//     stats              entl_tx_class_depth, entl_cycles_update
+//   Nothing else of the adapter is touched by the hooks, which is what a port to another e1000e release has to provide.
+#ifdef DEFINE_STATIC_KEY_FALSE
+DECLARE_STATIC_KEY_FALSE(entl_port_key);
+#define entl_port(adapter) (static_branch_unlikely(&entl_port_key) && (adapter)->entl_flag)
+#else
+#define entl_port(adapter) unlikely((adapter)->entl_flag)
+#endif
+
+/// turn ENTL on for the port, from probe or the DO_INIT ioctl. Process context, the key may sleep
+static void entl_port_enable( struct e1000_adapter *adapter ) ;
+
+/// turn it off again, from remove
+static void entl_port_disable( struct e1000_adapter *adapter ) ;
+
 /// initialize the entl device structure
 static void entl_device_init( entl_device_t *dev ) ;
 
+/// stop the watchdog of the link and release the AIT rings and the tx queues, from remove and the probe unwind
+static void entl_device_stop( entl_device_t *dev ) ;
+
 /// handle link up 
 static void entl_device_link_up( entl_device_t *dev ) ;
 
@@ -75,6 +296,24 @@ static int entl_do_ioctl(struct net_device *netdev, struct ifreq *ifr, int cmd)
 /// process the packet upon receive
 static bool entl_device_process_rx_packet( entl_device_t *dev, struct sk_buff *skb ) ;
 
+/// classify the frame from the rx buffer, false means drop it before any skb work
+static bool entl_rx_frame_wanted( entl_device_t *dev, const u8 *frame, unsigned int len ) ;
+
+/// run the ALO operation carried by the AIT, false if it is not one
+static bool entl_alo_execute( entl_device_t *dev, const struct entt_ioctl_ait_data *ait_data ) ;
+
+/// an Ack came with the result of our ALO operation
+static void entl_alo_result_received( entl_device_t *dev, const u8 *data ) ;
+
+/// process the frame in place in the rx buffer, the skb version calls it
+static bool entl_device_process_rx( entl_device_t *dev, const u8 *frame, unsigned int len ) ;
+
+#ifdef CONFIG_E1000E_NAPI
+/// page recycling rx path of ENTL ports, picked by entl_e1000_configure_rx for standard frames
+static void entl_alloc_rx_buffers( struct e1000_ring *rx_ring, int cleaned_count, gfp_t gfp ) ;
+static bool entl_clean_rx_irq( struct e1000_ring *rx_ring, int *work_done, int work_to_do ) ;
+#endif
+
 /// process the packet for transmit. 
 static void entl_device_process_tx_packet( entl_device_t *dev, struct sk_buff *skb ) ;
 
@@ -84,14 +323,85 @@ static void entl_e1000_configure(struct e1000_adapter *adapter) ;
 static void entl_e1000_set_my_addr( entl_device_t *dev, const u8 *addr ) ;
 
 
+/// number of data frames waiting for the token in all tx classes
 static int entl_tx_queue_has_data( entl_device_t *dev ) ;
 
+/// copy the depth of each tx class to the ethtool counters
+static void entl_tx_class_depth( entl_device_t *dev ) ;
+
+/// work out the cycles per event of the ethtool counters
+static void entl_cycles_update( entl_device_t *dev ) ;
+
 /// tx queue handling
 static netdev_tx_t entl_tx_transmit( struct sk_buff *skb, struct net_device *netdev ) ;
 
+/// pick RDTR/RADV/ITR from the token interval and the data backlog, replaces e1000_set_itr on ENTL ports
+static void entl_set_itr( struct e1000_adapter *adapter ) ;
+
+/// low-latency profile: hold a pm_qos cpu latency request, turn EEE and ASPM off on the port
+static void entl_lowlat_apply( struct e1000_adapter *adapter ) ;
+
+/// give back what entl_lowlat_apply changed, when the port leaves ENTL operation
+static void entl_lowlat_restore( struct e1000_adapter *adapter ) ;
+
+/// pin the port interrupts on the token core of the placement or, with the low-latency profile, on one cpu.
+///   Called after the irqs are requested
+static void entl_lowlat_pin_irq( struct e1000_adapter *adapter ) ;
+
+/// clear the irq affinity hint, called before the irqs are freed
+static void entl_lowlat_unpin_irq( struct e1000_adapter *adapter ) ;
+
+/// set the MAC up to timestamp the token exchange, called from entl_e1000_configure
+static void entl_hwts_start( struct e1000_adapter *adapter ) ;
+
+/// pick up the rx timestamp of the frame about to be processed
+static void entl_hwts_rx( struct e1000_adapter *adapter, u32 staterr ) ;
+
+/// a token was received, derive the wire round trip and one-way delay
+static void entl_hwts_token_received( entl_device_t *dev, const u8 *data, unsigned int len ) ;
+
+/// allocate the token ring on the second tx queue, called from e1000_open. Failing it just keeps the tokens on the data ring
+static void entl_token_ring_setup( struct e1000_adapter *adapter ) ;
+
+/// program the second tx queue, called from entl_e1000_configure after e1000_configure_tx
+static void entl_token_ring_configure( struct e1000_adapter *adapter ) ;
+
+/// free the frames still on the token ring and rewind it, called with the data ring cleanup
+static void entl_token_ring_reset( struct e1000_adapter *adapter ) ;
+
+/// release the token ring, called from e1000_close
+static void entl_token_ring_free( struct e1000_adapter *adapter ) ;
+
+/// start the busy poll thread if EntlBusyPoll is set for the port
+static void entl_busy_poll_start( struct e1000_adapter *adapter ) ;
+
+/// stop the busy poll thread, must be called before NAPI is disabled
+static void entl_busy_poll_stop( entl_device_t *dev ) ;
+
+/// the interrupt path saw traffic, let the busy poll thread take the rx ring over
+static void entl_busy_poll_kick( entl_device_t *dev ) ;
+
+/// start deferring the TDT update, called at the beginning of the NAPI rx processing
+static void entl_tx_batch_begin( entl_device_t *dev ) ;
+
+/// write TDT once for all descriptors queued since entl_tx_batch_begin
+static void entl_tx_batch_end( entl_device_t *dev ) ;
+
+/// free the queued skbs and size the tx queue for a tx ring of slots descriptors. The queue must be stopped.
+static void entl_tx_queue_reset( entl_device_t *dev, int slots ) ;
+
 /// send tx queue data to tx_ring
 static void entl_tx_pull( struct net_device *netdev ) ;
 
+/// hand the placement sysfs files to the device, before register_netdev
+static void entl_placement_sysfs( struct e1000_adapter *adapter ) ;
+
+/// put the port in the cpu placement layout, after register_netdev
+static void entl_placement_start( struct e1000_adapter *adapter ) ;
+
+/// take the port out of the layout, before unregister_netdev
+static void entl_placement_stop( struct e1000_adapter *adapter ) ;
+
 #endif    /* _IN_NETDEV_C_ */
 
 
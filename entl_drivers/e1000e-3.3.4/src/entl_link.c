@@ -0,0 +1,549 @@
+/*
+ * ENTL link layer
+ * Copyright(c) 2016 Earth Computing.
+ *
+ *   The token exchange around the state machine, the watchdog task with the Hello and the retry, the user
+ *   signals, the AIT rings and the ENTL/ENTT ioctls. The e1000e driver and entl_netdev both run their ports
+ *   on it and only differ in the entl_link_ops_t which moves the frames.
+ */
+#include <linux/sched.h>
+#include <linux/uaccess.h>
+#include <linux/etherdevice.h>
+#include <asm/unaligned.h>
+
+#include "entl_link.h"
+
+// the states in which the link is still coming up and Hello (or the retry of the last message) is due
+static bool entl_link_hello_state( __u32 state )
+{
+	return state == ENTL_STATE_HELLO || state == ENTL_STATE_WAIT || state == ENTL_STATE_RECEIVE || state == ENTL_STATE_AM || state == ENTL_STATE_BH ;
+}
+
+static void entl_link_set_dest( unsigned char *d_addr, __u16 u_addr, __u32 l_addr )
+{
+	d_addr[0] = u_addr >> 8 ;
+	d_addr[1] = u_addr ;
+	d_addr[2] = l_addr >> 24 ;
+	d_addr[3] = l_addr >> 16 ;
+	d_addr[4] = l_addr >> 8 ;
+	d_addr[5] = l_addr ;
+}
+
+// the token is the two addresses, each a 16 bit upper and 32 bit lower part in network order.
+//   One 8 byte load has the destination and the source upper part, one 4 byte load the source lower part.
+//   The rx buffer sits at a NET_IP_ALIGN offset or at any offset in the skb, so both loads are unaligned
+static inline void entl_rx_token_addr( const u8 *frame, u16 *s_u_addr, u32 *s_l_addr, u16 *d_u_addr, u32 *d_l_addr )
+{
+	u64 hi = get_unaligned_be64( frame ) ;
+
+	*d_u_addr = (u16)(hi >> 48) ;
+	*d_l_addr = (u32)(hi >> 16) ;
+	*s_u_addr = (u16)hi ;
+	*s_l_addr = get_unaligned_be32( frame + 8 ) ;
+}
+
+// AIT send completion from the state machine, called with the state lock held
+static void entl_link_ait_release( entl_state_machine_t *mcn, struct entt_ioctl_ait_data* data )
+{
+	entl_link_t *link = container_of( mcn, entl_link_t, stm ) ;
+
+	if( entt_ait_ring_owns( &link->ait_ring, data ) ) entt_ait_ring_complete( &link->ait_ring ) ;
+	else kfree( data ) ;
+}
+
+static void entl_link_signal( entl_link_t *link, int sig )
+{
+	struct siginfo info ;
+	struct task_struct *t ;
+
+	info.si_signo = SIGIO ;
+	info.si_int = 1 ;
+	info.si_code = SI_QUEUE ;
+	rcu_read_lock() ;
+	t = pid_task( find_vpid(link->user_pid), PIDTYPE_PID ) ;
+	if( t == NULL ) {
+		ENTL_DEBUG("ENTL %s no such pid, cannot send signal\n", link->netdev->name );
+	}
+	else {
+		ENTL_DEBUG("ENTL %s found the task, sending signal %d\n", link->netdev->name, sig );
+		send_sig_info( sig, &info, t ) ;
+	}
+	rcu_read_unlock() ;
+}
+
+/**
+ * entl_link_watchdog_timer - Timer Call-back
+ * @data: pointer to the link cast into an unsigned long
+ **/
+static void entl_link_watchdog_timer( unsigned long data )
+{
+	entl_link_t *link = (entl_link_t *)data ;
+	int cpu = READ_ONCE( link->work_cpu ) ;
+
+	if( READ_ONCE(link->stopping) ) return ;
+	/* Do the rest outside of interrupt context */
+	if( cpu >= 0 && cpu_online( cpu ) ) schedule_work_on( cpu, &link->watchdog_task ) ;   // on the token core of the port
+	else schedule_work( &link->watchdog_task ) ;           // schedule task using the global kernel work queue
+}
+
+static void entl_link_watchdog_task( struct work_struct *work )
+{
+	entl_link_watchdog( container_of( work, entl_link_t, watchdog_task ) ) ;
+}
+
+void entl_link_init( entl_link_t *link, const entl_link_ops_t *ops, struct net_device *netdev )
+{
+	link->ops = ops ;
+	link->netdev = netdev ;
+	link->work_cpu = -1 ;
+
+	// watchdog timer & task setup
+	init_timer( &link->watchdog_timer ) ;
+	link->watchdog_timer.function = entl_link_watchdog_timer ;
+	link->watchdog_timer.data = (unsigned long)link ;
+	INIT_WORK( &link->watchdog_task, entl_link_watchdog_task ) ;
+}
+
+void entl_link_reset( entl_link_t *link )
+{
+	entl_state_machine_init( &link->stm ) ;
+	strlcpy( link->stm.name, link->netdev->name, sizeof(link->stm.name) ) ;
+	link->stm.ait_release = entl_link_ait_release ;
+	entt_ait_ring_reset( &link->ait_ring ) ;
+	entt_ait_ring_refill( &link->ait_ring ) ;
+}
+
+void entl_link_set_addr( entl_link_t *link, const u8 *addr )
+{
+	ENTL_DEBUG("entl_link_set_addr set %d.%d.%d.%d.%d.%d\n", addr[0], addr[1], addr[2], addr[3], addr[4], addr[5] );
+	entl_set_my_adder( &link->stm, (u16)addr[0] << 8 | addr[1], (u32)addr[2] << 24 | (u32)addr[3] << 16 | (u32)addr[4] << 8 | (u32)addr[5] ) ;
+}
+
+void entl_link_start( entl_link_t *link )
+{
+	WRITE_ONCE( link->stopping, 0 ) ;
+}
+
+// the task re-arms the timer and the timer queues the task, so neither may start again once stopping is seen,
+//   and the timer is killed again after the last task run
+void entl_link_stop( entl_link_t *link )
+{
+	WRITE_ONCE( link->stopping, 1 ) ;
+	del_timer_sync( &link->watchdog_timer ) ;
+	cancel_work_sync( &link->watchdog_task ) ;
+	del_timer_sync( &link->watchdog_timer ) ;
+}
+
+void entl_link_kick( entl_link_t *link )
+{
+	if( !READ_ONCE(link->stopping) ) mod_timer( &link->watchdog_timer, jiffies + 1 ) ;
+}
+
+// first SEND after the link came up, the port is entangled
+static void entl_link_entangled( entl_link_t *link )
+{
+	u64 ns = ktime_get_ns() - link->link_up_ns ;
+
+	link->link_up_ns = 0 ;
+	WRITE_ONCE( link->stats.entangle_last_ns, ns ) ;
+	if( ns > link->stats.entangle_max_ns ) WRITE_ONCE( link->stats.entangle_max_ns, ns ) ;
+	ENTL_STAT_INC( link, entangles ) ;
+	ENTL_DEBUG("ENTL %s entangled %llu ns after link up\n", link->netdev->name, ns );
+}
+
+void entl_link_carrier_on( entl_link_t *link )
+{
+	ENTL_DEBUG("ENTL %s entl_link_carrier_on called\n", link->netdev->name );
+	entl_link_up( &link->stm ) ;
+	link->flag |= ENTL_DEVICE_FLAG_SIGNAL ;
+	if( link->stm.current_state.current_state == ENTL_STATE_HELLO ) {
+		link->link_up_ns = ktime_get_ns() ;
+		link->hello_wait = msecs_to_jiffies( link->hello_ms ) ? : 1 ;
+		// Hello right away from here, the watchdog task retries it on the short timer
+		if( entl_link_send_hello( link ) ) link->flag |= ENTL_DEVICE_FLAG_HELLO ;
+	}
+	entl_link_kick( link ) ; // trigger timer
+}
+
+void entl_link_carrier_off( entl_link_t *link )
+{
+	ENTL_DEBUG("ENTL %s entl_link_carrier_off called\n", link->netdev->name );
+	entl_state_error( &link->stm, ENTL_ERROR_FLAG_LINKDONW ) ;
+	link->flag = ENTL_DEVICE_FLAG_SIGNAL ;  // clear other flag and just signal
+	link->ait_swallow_sig = 0 ;
+	link->link_up_ns = 0 ;
+	entl_link_kick( link ) ; // trigger timer
+}
+
+int entl_link_send_hello( entl_link_t *link )
+{
+	__u16 u_addr ;
+	__u32 l_addr ;
+	int ret, result ;
+
+	if( !netif_carrier_ok(link->netdev) ) return -ENOLINK ;
+	// the rx path runs in the softirq, keep it off this cpu while sending
+	local_bh_disable() ;
+	result = link->ops->tx_ready( link ) ;
+	if( result == 0 ) {
+		if( (ret = entl_get_hello( &link->stm, &u_addr, &l_addr )) ) result = link->ops->inject( link, u_addr, l_addr, ret ) ;
+		else result = -EAGAIN ;
+	}
+	local_bh_enable() ;
+	if( result == 0 ) {
+		link->flag &= ~(__u32)ENTL_DEVICE_FLAG_HELLO ;
+		ENTL_STAT_INC( link, hellos_sent ) ;
+		ENTL_DEBUG("ENTL %s entl_link_send_hello %04x %08x packet sent\n", link->netdev->name, u_addr, l_addr );
+	}
+	else if( result == -EAGAIN ) {
+		ENTL_DEBUG("ENTL %s entl_link_send_hello hello state lost\n", link->netdev->name );
+	}
+	return result ;
+}
+
+void entl_link_watchdog( entl_link_t *link )
+{
+	unsigned long wakeup = 1 * HZ ;  // one second
+	int result ;
+
+	if( !link->flag ) {
+		link->flag |= ENTL_DEVICE_FLAG_WAITING ;
+		goto restart_watchdog ;
+	}
+	if( (link->flag & ENTL_DEVICE_FLAG_SIGNAL) && link->user_pid ) {
+		link->flag &= ~(__u32)ENTL_DEVICE_FLAG_SIGNAL ;
+		entl_link_signal( link, SIGUSR1 ) ;
+	}
+	else if( (link->flag & ENTL_DEVICE_FLAG_SIGNAL2) && link->user_pid ) {
+		link->flag &= ~(__u32)ENTL_DEVICE_FLAG_SIGNAL2 ;
+		entl_link_signal( link, SIGUSR2 ) ;
+	}
+	if( netif_carrier_ok(link->netdev) && (link->flag & ENTL_DEVICE_FLAG_HELLO) ) {
+		ENTL_DEBUG("ENTL %s entl_link_watchdog trying to send hello\n", link->netdev->name );
+		if( entl_link_hello_state( link->stm.current_state.current_state ) ) {
+			result = entl_link_send_hello( link ) ;
+			if( result ) {
+				ENTL_DEBUG("ENTL %s entl_link_watchdog hello packet failed with %d\n", link->netdev->name, result );
+			}
+		}
+		else {
+			link->flag &= ~(__u32)ENTL_DEVICE_FLAG_HELLO ;
+			if( link->stm.current_state.current_state != ENTL_STATE_IDLE ) {
+				ENTL_DEBUG("ENTL %s entl_link_watchdog not hello/wait state but %d\n", link->netdev->name, link->stm.current_state.current_state );
+			}
+		}
+	}
+	else if( link->flag & ENTL_DEVICE_FLAG_RETRY ) {
+		ENTL_DEBUG("ENTL %s entl_link_watchdog sending retry\n", link->netdev->name );
+		local_bh_disable() ;
+		result = link->ops->tx_ready( link ) ;
+		if( result == 0 ) {
+			ENTL_STAT_INC( link, retries ) ;
+			result = link->ops->inject( link, link->u_addr, link->l_addr, link->action ) ;
+		}
+		local_bh_enable() ;
+		if( result == 0 ) {
+			link->flag &= ~(__u32)ENTL_DEVICE_FLAG_RETRY ;
+			link->flag &= ~(__u32)ENTL_DEVICE_FLAG_WAITING ;
+			ENTL_DEBUG("ENTL %s entl_link_watchdog retry packet sent\n", link->netdev->name );
+		}
+		else {
+			ENTL_DEBUG("ENTL %s entl_link_watchdog retry packet failed with %d\n", link->netdev->name, result );
+		}
+	}
+	else if( link->flag & ENTL_DEVICE_FLAG_WAITING ) {
+		link->flag &= ~(__u32)ENTL_DEVICE_FLAG_WAITING ;
+		if( entl_link_hello_state( link->stm.current_state.current_state ) ) {
+			link->flag |= ENTL_DEVICE_FLAG_HELLO ;
+			ENTL_STAT_INC( link, hello_timeouts ) ;
+			ENTL_DEBUG("ENTL %s entl_link_watchdog retry message sending\n", link->netdev->name );
+		}
+	}
+restart_watchdog:
+	if( READ_ONCE(link->stopping) ) return ;
+	if( netif_carrier_ok(link->netdev) && (link->stm.current_state.current_state == ENTL_STATE_HELLO || link->stm.current_state.current_state == ENTL_STATE_WAIT) ) {
+		// not entangled yet, Hello again on the short timer, backing off to the one second tick
+		link->flag |= ENTL_DEVICE_FLAG_HELLO ;
+		wakeup = link->hello_wait ? : 1 ;
+		link->hello_wait = min_t( unsigned long, wakeup * 2, HZ ) ;
+		mod_timer( &link->watchdog_timer, jiffies + wakeup ) ;
+	}
+	else {
+		mod_timer( &link->watchdog_timer, round_jiffies(jiffies + wakeup) ) ;
+	}
+}
+
+// inject the next message, or have the watchdog task retry it. Returns the action of the message
+static int entl_link_send_message( entl_link_t *link )
+{
+	__u16 d_u_addr ;
+	__u32 d_l_addr ;
+	int ret, result ;
+
+	ret = entl_next_send( &link->stm, &d_u_addr, &d_l_addr ) ;
+	if( (d_u_addr & (u16)ENTL_MESSAGE_MASK) == ENTL_MESSAGE_NOP_U ) return 0 ;  // last minute check
+
+	result = link->ops->inject( link, d_u_addr, d_l_addr, ret ) ;
+	// AIT send completed, the ring may have more for the state machine
+	if( ret & ENTL_ACTION_SIG_AIT ) entt_ait_ring_refill( &link->ait_ring ) ;
+	// if failed to inject message, so invoke the task
+	if( result == 1 ) {
+		// resource error, so retry
+		link->u_addr = d_u_addr ;
+		link->l_addr = d_l_addr ;
+		link->action = ret ;
+		link->flag |= ENTL_DEVICE_FLAG_RETRY ;
+		entl_link_kick( link ) ; // trigger timer
+	}
+	else if( result == -1 ) {
+		entl_state_error( &link->stm, ENTL_ERROR_FATAL ) ;
+		link->flag |= ENTL_DEVICE_FLAG_SIGNAL ;
+		entl_link_kick( link ) ; // trigger timer
+	}
+	else {
+		// clear watchdog flag
+		link->flag &= ~(__u32)ENTL_DEVICE_FLAG_WAITING ;
+	}
+	return ret ;
+}
+
+int entl_link_copy_linear( const void *from, int offset, void *to, int len )
+{
+	memcpy( to, (const u8 *)from + offset, len ) ;
+	return 0 ;
+}
+
+// the AIT length comes first, then the message
+static void entl_link_read_ait( entl_link_t *link, struct entt_ioctl_ait_data *ait_data, entl_link_copy_t copy, const void *from, unsigned int len )
+{
+	if( len < sizeof(u32) || copy( from, 0, &ait_data->message_len, sizeof(u32) ) ) return ;
+	if( ait_data->message_len && ait_data->message_len < MAX_AIT_MESSAGE_SIZE && ait_data->message_len <= len - sizeof(u32) ) {
+		if( copy( from, sizeof(u32), ait_data->data, ait_data->message_len ) == 0 ) return ;
+	}
+	ENTL_DEBUG("ENTL %s entl_link_rx got bad message_len %d\n", link->netdev->name, ait_data->message_len );
+	ait_data->message_len = 0 ;
+}
+
+int entl_link_rx( entl_link_t *link, const u8 *hdr, entl_link_copy_t copy, const void *from, unsigned int len )
+{
+	int result ;
+	u16 s_u_addr, d_u_addr ;
+	u32 s_l_addr, d_l_addr ;
+
+	entl_rx_token_addr( hdr, &s_u_addr, &s_l_addr, &d_u_addr, &d_l_addr ) ;
+
+	if( (d_u_addr & ENTL_MESSAGE_ONLY_U) && (d_u_addr & ENTL_MESSAGE_MASK) != ENTL_MESSAGE_NOP_U && (d_u_addr & ENTL_MESSAGE_MASK) != ENTL_MESSAGE_HELLO_U ) {
+		ENTL_STAT_INC( link, tokens_received ) ;
+	}
+
+	result = entl_received( &link->stm, s_u_addr, s_l_addr, d_u_addr, d_l_addr ) ;
+	if( unlikely(link->link_up_ns) && link->stm.current_state.current_state == ENTL_STATE_SEND ) entl_link_entangled( link ) ;
+
+	if( result == ENTL_ACTION_ERROR ) {
+		// error, need to send signal & hello
+		ENTL_STAT_INC( link, hello_restarts ) ;
+		link->hello_wait = msecs_to_jiffies( link->hello_ms ) ? : 1 ;
+		link->flag |= ENTL_DEVICE_FLAG_HELLO | ENTL_DEVICE_FLAG_SIGNAL ;
+		entl_link_kick( link ) ; // trigger timer
+		return result ;
+	}
+	if( result == ENTL_ACTION_SIG_ERR ) {  // request for signal as error flag is set
+		link->flag |= ENTL_DEVICE_FLAG_SIGNAL ;
+		entl_link_kick( link ) ; // trigger timer
+		return result ;
+	}
+	if( result & ENTL_ACTION_PROC_AIT ) {
+		// AIT message is received, put in to the receive buffer
+		struct entt_ioctl_ait_data *ait_data = kzalloc( sizeof(struct entt_ioctl_ait_data), GFP_ATOMIC ) ;
+		if( ait_data ) {
+			entl_link_read_ait( link, ait_data, copy, from, len ) ;
+			if( link->ops->ait_consume && link->ops->ait_consume( link, ait_data ) ) {
+				// consumed by the driver, the user never sees it
+				kfree( ait_data ) ;
+				link->ait_swallow_sig = 1 ;
+			}
+			else {
+				entl_new_AIT_message( &link->stm, ait_data ) ;
+				ENTL_STAT_INC( link, ait_received ) ;
+			}
+		}
+	}
+	if( result & ENTL_ACTION_SIG_AIT ) {
+		// ring users poll the recv ring, others get the signal
+		if( link->ait_swallow_sig ) link->ait_swallow_sig = 0 ;
+		else if( !entt_ait_ring_active( &link->ait_ring ) || entt_ait_ring_deliver( &link->ait_ring ) == 0 ) {
+			link->flag |= ENTL_DEVICE_FLAG_SIGNAL2 ;
+		}
+	}
+	if( result & ENTL_ACTION_SEND ) {
+		// SEND_DAT flag is set on SEND state to check if TX queue has data
+		if( !(result & ENTL_ACTION_SEND_DAT) || !link->ops->send_data( link ) ) {
+			result |= entl_link_send_message( link ) & ENTL_ACTION_SEND_AIT ;
+		}
+	}
+	return result ;
+}
+
+void entl_link_tx_token( entl_link_t *link, struct ethhdr *eth )
+{
+	__u16 u_addr ;
+	__u32 l_addr ;
+	int ret = entl_next_send_tx( &link->stm, &u_addr, &l_addr ) ;
+
+	if( ret & ENTL_ACTION_SIG_AIT ) {
+		link->flag |= ENTL_DEVICE_FLAG_SIGNAL2 ;  // AIT send completion signal
+		entt_ait_ring_refill( &link->ait_ring ) ;
+	}
+	entl_link_set_dest( eth->h_dest, u_addr, l_addr ) ;
+	if( u_addr != ENTL_MESSAGE_NOP_U ) {
+		link->flag &= ~(__u32)ENTL_DEVICE_FLAG_WAITING ;
+	}
+}
+
+int entl_link_message_len( entl_link_t *link, int action, struct entt_ioctl_ait_data **ait, u32 *ait_len )
+{
+	int len = ETH_HLEN ;
+
+	*ait = NULL ;
+	*ait_len = 0 ;
+	if( action & ENTL_ACTION_SEND_AIT ) {
+		*ait = entl_next_AIT_message( &link->stm ) ;
+		// the message may sit in the user mapped ring, so read the length once and clamp it
+		if( *ait ) *ait_len = min_t( u32, READ_ONCE((*ait)->message_len), MAX_AIT_MESSAGE_SIZE ) ;
+		len += sizeof(u32) + *ait_len ;
+	}
+	if( len < ETH_ZLEN ) len = ETH_ZLEN ; // min length = 60 defined in include/uapi/linux/if_ether.h
+	return len ;
+}
+
+u8 *entl_link_message_fill( u8 *frame, unsigned int len, const u8 *src, __u16 u_addr, __u32 l_addr, const struct entt_ioctl_ait_data *ait, u32 ait_len )
+{
+	struct ethhdr *eth = (struct ethhdr *)frame ;
+	u8 *cp = frame + ETH_HLEN ;
+
+	memset( frame, 0, len ) ;
+	entl_link_set_dest( eth->h_dest, u_addr | ENTL_MESSAGE_ONLY_U, l_addr ) ; // set messege only flag
+	memcpy( eth->h_source, src, ETH_ALEN ) ;
+	eth->h_proto = 0 ; // protocol type is not used anyway
+	if( ait ) {
+		memcpy( cp, &ait_len, sizeof(u32) ) ;
+		memcpy( cp + sizeof(u32), ait->data, ait_len ) ;
+	}
+	return cp ;
+}
+
+static void dump_state( char *type, entl_state_t *st, int flag )
+{
+	ENTL_DEBUG( "%s event_i_know: %d  event_i_sent: %d event_send_next: %d current_state: %d error_flag %x p_error %x error_count %d @ %ld.%ld \n",
+		type, st->event_i_know, st->event_i_sent, st->event_send_next, st->current_state, st->error_flag, st->p_error_flag, st->error_count, st->update_time.tv_sec, st->update_time.tv_nsec
+	) ;
+	if( st->error_flag ) {
+		ENTL_DEBUG( "  Error time: %ld.%ld\n", st->error_time.tv_sec, st->error_time.tv_nsec ) ;
+	}
+#ifdef ENTL_SPEED_CHECK
+	if( flag ) {
+		ENTL_DEBUG( "  interval_time    : %ld.%ld\n", st->interval_time.tv_sec, st->interval_time.tv_nsec ) ;
+		ENTL_DEBUG( "  max_interval_time: %ld.%ld\n", st->max_interval_time.tv_sec, st->max_interval_time.tv_nsec ) ;
+		ENTL_DEBUG( "  min_interval_time: %ld.%ld\n", st->min_interval_time.tv_sec, st->min_interval_time.tv_nsec ) ;
+	}
+#endif
+}
+
+int entl_link_ioctl( entl_link_t *link, struct ifreq *ifr, int cmd )
+{
+	struct net_device *netdev = link->netdev ;
+	struct entl_ioctl_data entl_data ;
+
+	switch( cmd )
+	{
+	case SIOCDEVPRIVATE_ENTL_RD_CURRENT:
+	case SIOCDEVPRIVATE_ENTL_RD_ERROR:
+		memset( &entl_data, 0, sizeof(entl_data) ) ;
+		if( cmd == SIOCDEVPRIVATE_ENTL_RD_CURRENT ) entl_read_current_state( &link->stm, &entl_data.state, &entl_data.error_state ) ;
+		else entl_read_error_state( &link->stm, &entl_data.state, &entl_data.error_state ) ;
+		entl_data.num_queued = entl_num_queued( &link->stm ) ;
+		entl_data.data_tokens = link->data_tokens ;
+		entl_data.data_frames = link->data_frames ;
+		entl_data.entangles = (u32)READ_ONCE( link->stats.entangles ) ;
+		entl_data.entangle_ns = (u32)READ_ONCE( link->stats.entangle_last_ns ) ;
+		link->ops->read_state( link, &entl_data ) ;
+		if( copy_to_user( ifr->ifr_data, &entl_data, sizeof(struct entl_ioctl_data) ) ) return -EFAULT ;
+		if( cmd == SIOCDEVPRIVATE_ENTL_RD_ERROR ) {
+			dump_state( "current", &entl_data.state, 1 ) ;
+			dump_state( "error", &entl_data.error_state, 0 ) ;
+		}
+		break ;
+	case SIOCDEVPRIVATE_ENTL_SET_SIGRCVR:
+		if( copy_from_user( &entl_data, ifr->ifr_data, sizeof(struct entl_ioctl_data) ) ) return -EFAULT ;
+		ENTL_DEBUG("ENTL %s ioctl user_pid %d is set\n", netdev->name, entl_data.pid );
+		link->user_pid = entl_data.pid ;
+		break ;
+	case SIOCDEVPRIVATE_ENTL_GEN_SIGNAL:
+		ENTL_DEBUG("ENTL %s ioctl got SIOCDEVPRIVATE_ENTL_GEN_SIGNAL\n", netdev->name );
+		break ;
+	case SIOCDEVPRIVATE_ENTT_SEND_AIT:
+	{
+		struct entt_ioctl_ait_data* ait_data ;
+		int ret ;
+		ait_data = kzalloc( sizeof(struct entt_ioctl_ait_data), GFP_KERNEL ) ;
+		if( !ait_data ) return -ENOMEM ;
+		if( copy_from_user( ait_data, ifr->ifr_data, sizeof(struct entt_ioctl_ait_data) ) ) {
+			kfree( ait_data ) ;
+			return -EFAULT ;
+		}
+		if( ait_data->message_len > MAX_AIT_MESSAGE_SIZE ) ait_data->message_len = MAX_AIT_MESSAGE_SIZE ;
+		ret = entl_send_AIT_message( &link->stm, ait_data ) ;
+		ENTL_DEBUG("ENTL %s ioctl send %d byte AIT, %d left\n", netdev->name, ait_data->message_len, ret );
+		// error, dealloc data. Otherwise the state machine owns it and may have sent it already
+		if( ret < 0 ) kfree( ait_data ) ;
+		// return how many buffer left
+		if( put_user( ret, &((struct entt_ioctl_ait_data __user *)ifr->ifr_data)->num_messages ) ) return -EFAULT ;
+	}
+		break ;
+	case SIOCDEVPRIVATE_ENTT_READ_AIT:
+	{
+		struct entt_ioctl_ait_data* ait_data = entl_read_AIT_message( &link->stm ) ;
+		if( ait_data ) {
+			int err ;
+			ENTL_DEBUG("ENTL %s ioctl got %d byte AIT, %d left\n", netdev->name, ait_data->message_len, ait_data->num_messages );
+			err = copy_to_user( ifr->ifr_data, ait_data, sizeof(struct entt_ioctl_ait_data) ) ;
+			kfree( ait_data ) ;
+			if( err ) return -EFAULT ;
+		}
+		else {
+			struct entt_ioctl_ait_data dt ;
+			memset( &dt, 0, sizeof(dt) ) ;
+			dt.num_queued = entl_num_queued( &link->stm ) ;
+			if( copy_to_user( ifr->ifr_data, &dt, sizeof(struct entt_ioctl_ait_data) ) ) return -EFAULT ;
+		}
+	}
+		break ;
+	case SIOCDEVPRIVATE_ENTL_FLAP:
+		if( !netif_carrier_ok(netdev) ) return -ENOLINK ;
+		ENTL_DEBUG("ENTL %s ioctl flap\n", netdev->name );
+		entl_link_carrier_off( link ) ;
+		// take the link down error off as the user would, so the link up goes to Hello
+		entl_read_error_state( &link->stm, &entl_data.state, &entl_data.error_state ) ;
+		entl_link_carrier_on( link ) ;
+		break ;
+	case SIOCDEVPRIVATE_ENTT_RING_SETUP:
+	{
+		int err = entt_ait_ring_create( &link->ait_ring, &link->stm, netdev->name ) ;
+		ENTL_DEBUG("ENTL %s ioctl ring setup %s returns %d\n", netdev->name, link->ait_ring.misc_name, err );
+		if( err ) return err ;
+		// messages already received go to the ring from now on
+		entt_ait_ring_deliver( &link->ait_ring ) ;
+	}
+		break ;
+	case SIOCDEVPRIVATE_ENTT_RING_DOORBELL:
+		if( !entt_ait_ring_active( &link->ait_ring ) ) return -ENODEV ;
+		entt_ait_ring_refill( &link->ait_ring ) ;
+		// the user reaped the recv ring, the messages left in the state machine can go now
+		entt_ait_ring_deliver( &link->ait_ring ) ;
+		break ;
+	default:
+		ENTL_DEBUG("ENTL %s ioctl error: undefined cmd %d\n", netdev->name, cmd);
+		return -EOPNOTSUPP ;
+	}
+	return 0 ;
+}
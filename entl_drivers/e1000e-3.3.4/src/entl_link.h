@@ -0,0 +1,152 @@
+/*
+ * ENTL link layer
+ * Copyright(c) 2016 Earth Computing.
+ *
+ */
+#ifndef _ENTL_LINK_H_
+#define _ENTL_LINK_H_
+
+#include <linux/netdevice.h>
+#include <linux/if_ether.h>
+#include <linux/timer.h>
+#include <linux/workqueue.h>
+
+#include "entl_state_machine.h"
+#include "entl_ait_ring.h"
+
+// these flags are used to request tasks to the watchdog task
+#define ENTL_DEVICE_FLAG_HELLO 		1
+#define ENTL_DEVICE_FLAG_SIGNAL 	2
+#define ENTL_DEVICE_FLAG_RETRY 		4
+#define ENTL_DEVICE_FLAG_WAITING 	8
+#define ENTL_DEVICE_FLAG_SIGNAL2	0x10
+
+#define ENTL_DEVICE_FLAG_FATAL 0x8000
+
+// counters with a single writer are bumped with a plain store and read without a lock
+#define ENTL_STAT_INC(dev, m) WRITE_ONCE( (dev)->stats.m, (dev)->stats.m + 1 )
+
+// link counters, the rx path writes the token, AIT and entangle counters, the watchdog task the others
+typedef struct entl_link_stats {
+    u64 tokens_received ;           // non NOP/Hello messages received
+    u64 ait_received ;
+    u64 retries ;                   // messages re-sent by the watchdog task
+    u64 hello_restarts ;            // the state machine fell back to Hello on an error
+    u64 hello_timeouts ;            // Hello re-sent as the exchange stalled
+    u64 hellos_sent ;               // Hello (or the Wait event) sent while the link comes up
+    u64 entangles ;                 // link ups which reached SEND
+    u64 entangle_last_ns ;          // link up to the first SEND, last time
+    u64 entangle_max_ns ;
+} entl_link_stats_t ;
+
+struct entl_link ;
+
+/// copy len bytes at offset of a received payload to to, 0 if OK. The skb_copy_bits signature
+typedef int (*entl_link_copy_t)( const void *from, int offset, void *to, int len ) ;
+
+/// What the link needs of the device under it, the e1000e tx ring or a net_device under entl_netdev.
+///   inject, tx_ready and send_data run with the bottom halves off, from the rx path or the watchdog task
+typedef struct entl_link_ops {
+	/// send a message only frame, 0 if success, 1 if need to retry due to resource, -1 if fatal
+	int (*inject)( struct entl_link *link, __u16 u_addr, __u32 l_addr, int action ) ;
+	/// room for a message only frame now, 0 or -ENETDOWN/-EBUSY
+	int (*tx_ready)( struct entl_link *link ) ;
+	/// send the data frames waiting for the token, the first one carries it. false if none waits
+	bool (*send_data)( struct entl_link *link ) ;
+	/// the device part of SIOCDEVPRIVATE_ENTL_RD_CURRENT/RD_ERROR, link_state and the timing
+	void (*read_state)( struct entl_link *link, struct entl_ioctl_data *data ) ;
+	/// optional, take the received AIT for the driver itself (the ALO operations), true if taken
+	bool (*ait_consume)( struct entl_link *link, const struct entt_ioctl_ait_data *ait_data ) ;
+} entl_link_ops_t ;
+
+/// The device independent part of an ENTL port: the state machine and its watchdog, the user signals,
+///   the AIT rings and the ENTL/ENTT ioctls. The port structure of each driver embeds one
+typedef struct entl_link {
+	const entl_link_ops_t *ops ;
+	struct net_device *netdev ;            /// the device the user sees, its carrier is the link state
+
+	entl_state_machine_t stm ;             /// the state machine structure
+
+	struct timer_list watchdog_timer ;     /// watchdog time for this link
+	struct work_struct watchdog_task ;     /// hello, retry and signals outside of the softirq
+	int work_cpu ;                         /// cpu for the watchdog work, -1 for any
+	int stopping ;                         /// entl_link_stop runs, the timer and the task are not armed again
+
+	// flag is used to set a request to the watchdog task
+	__u32 flag ;
+
+	// keep the last value to be sent for retry
+	__u16 u_addr ;
+	__u32 l_addr ;
+	int action ;
+
+	int user_pid ;                         /// user process id to send the signal
+	int ait_swallow_sig ;                  /// the AIT went to ait_consume, so no message for the user when the exchange ends
+
+	// link bring-up
+	u32 hello_ms ;                         /// first Hello retry after link up, doubles up to a second
+	unsigned long hello_wait ;             /// next retry in jiffies, watchdog task only
+	u64 link_up_ns ;                       /// ktime_get_ns of the link up, 0 once entangled
+
+	u32 data_tokens ;                      /// tokens which carried data, counted by send_data
+	u32 data_frames ;                      /// data frames sent on those tokens
+
+	entt_ait_ring_t ait_ring ;             /// shared-memory AIT rings, set up on SIOCDEVPRIVATE_ENTT_RING_SETUP
+
+	entl_link_stats_t stats ;
+} entl_link_t ;
+
+/// set up the timer and the task, once when the port is created. The link must be zeroed
+void entl_link_init( entl_link_t *link, const entl_link_ops_t *ops, struct net_device *netdev ) ;
+
+/// start the state machine over, from open or the DO_INIT ioctl. The address is set with entl_link_set_addr
+void entl_link_reset( entl_link_t *link ) ;
+
+/// our MAC address for the Hello handling
+void entl_link_set_addr( entl_link_t *link, const u8 *addr ) ;
+
+/// let the watchdog run again after entl_link_stop
+void entl_link_start( entl_link_t *link ) ;
+
+/// stop the watchdog for good, the timer and the task are idle on return. Process context
+void entl_link_stop( entl_link_t *link ) ;
+
+/// run the watchdog task soon, unless the link is stopping
+void entl_link_kick( entl_link_t *link ) ;
+
+/// the carrier came up, Hello goes out right away
+void entl_link_carrier_on( entl_link_t *link ) ;
+
+/// the carrier went down
+void entl_link_carrier_off( entl_link_t *link ) ;
+
+/// the work of the watchdog task: signals, Hello, retry and the Hello backoff. For a driver which wraps
+///   its own task function around it
+void entl_link_watchdog( entl_link_t *link ) ;
+
+/// send what entl_get_hello asks for in the current state, 0 when it went out
+int entl_link_send_hello( entl_link_t *link ) ;
+
+/// process the token of a received frame and send the answer, in the softirq. hdr is the Ethernet header,
+///   the AIT payload behind it is read by copy from from, len bytes. Returns the entl_received action, with
+///   ENTL_ACTION_SEND_AIT added when the answer carried an AIT
+int entl_link_rx( entl_link_t *link, const u8 *hdr, entl_link_copy_t copy, const void *from, unsigned int len ) ;
+
+/// entl_link_copy_t of a payload in one piece
+int entl_link_copy_linear( const void *from, int offset, void *to, int len ) ;
+
+/// a data frame is leaving: put the next message in its destination address
+void entl_link_tx_token( entl_link_t *link, struct ethhdr *eth ) ;
+
+/// length of the message only frame for the action, without the FCS. The AIT to send is read here,
+///   *ait_len once and clamped, *ait is NULL without one
+int entl_link_message_len( entl_link_t *link, int action, struct entt_ioctl_ait_data **ait, u32 *ait_len ) ;
+
+/// write the len bytes of the message only frame from src, with the AIT if there is one. Returns where
+///   the payload goes, for the driver's own data on the frames without AIT
+u8 *entl_link_message_fill( u8 *frame, unsigned int len, const u8 *src, __u16 u_addr, __u32 l_addr, const struct entt_ioctl_ait_data *ait, u32 ait_len ) ;
+
+/// the ENTL/ENTT ioctls, -EOPNOTSUPP for the ones left to the driver
+int entl_link_ioctl( entl_link_t *link, struct ifreq *ifr, int cmd ) ;
+
+#endif
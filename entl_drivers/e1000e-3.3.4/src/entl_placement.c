@@ -0,0 +1,138 @@
+/*
+ * ENTL cpu placement of the ports
+ * Copyright(c) 2016 Earth Computing.
+ *
+ *   With several ENTL ports in a cell the interrupts and the watchdog work of all of them end up on cpu 0,
+ *   where the data softirqs compete with the token exchange. The layout gives each port a core for its
+ *   tokens and spreads the data over the cpus left on the node.
+ */
+#include <linux/mutex.h>
+#include <linux/topology.h>
+#include <linux/kernel.h>
+
+#include "entl_placement.h"
+
+static LIST_HEAD(entl_placement_ports) ;
+static DEFINE_MUTEX(entl_placement_lock) ;          // protects the list, the port placements and the masks below
+
+// scratch masks for entl_placement_layout, too big for the stack with a large NR_CPUS
+static struct cpumask entl_placement_taken ;
+static struct cpumask entl_placement_cand ;
+
+// the online cpus of the node, without cpu 0 unless nothing else is left
+static void entl_placement_candidates( int node, struct cpumask *mask )
+{
+	if( node != NUMA_NO_NODE ) cpumask_and( mask, cpumask_of_node(node), cpu_online_mask ) ;
+	if( node == NUMA_NO_NODE || cpumask_empty( mask ) ) cpumask_copy( mask, cpu_online_mask ) ;
+	if( cpumask_weight( mask ) > 1 ) cpumask_clear_cpu( 0, mask ) ;
+}
+
+static int entl_placement_nth( const struct cpumask *mask, unsigned int n )
+{
+	int cpu ;
+
+	n %= cpumask_weight( mask ) ;
+	for_each_cpu( cpu, mask ) {
+		if( !n-- ) return cpu ;
+	}
+	return cpumask_first( mask ) ;
+}
+
+// called with entl_placement_lock held
+static void entl_placement_layout( void )
+{
+	struct cpumask *taken = &entl_placement_taken ;
+	struct cpumask *cand = &entl_placement_cand ;
+	entl_placement_t *pl ;
+	unsigned int shared = 0 ;
+
+	// the cores fixed by the user first, no other port is put on them
+	cpumask_clear( taken ) ;
+	list_for_each_entry( pl, &entl_placement_ports, list ) {
+		if( pl->fixed_token_cpu >= 0 && cpu_online( pl->fixed_token_cpu ) ) cpumask_set_cpu( pl->fixed_token_cpu, taken ) ;
+	}
+
+	// one free core per port, when there are more ports than cores they share in turn
+	list_for_each_entry( pl, &entl_placement_ports, list ) {
+		int cpu = pl->fixed_token_cpu ;
+
+		if( cpu < 0 || !cpu_online( cpu ) ) {
+			entl_placement_candidates( pl->node, cand ) ;
+			cpumask_andnot( &pl->data_cpus, cand, taken ) ;  // scratch here, set in the next pass
+			cpu = cpumask_first( &pl->data_cpus ) ;
+			if( cpu >= nr_cpu_ids ) cpu = entl_placement_nth( cand, shared++ ) ;
+			cpumask_set_cpu( cpu, taken ) ;
+		}
+		pl->token_cpu = cpu ;
+	}
+
+	// the data goes to what is left on the node, or to the port's own core if nothing is
+	list_for_each_entry( pl, &entl_placement_ports, list ) {
+		if( !cpumask_empty( &pl->fixed_data_cpus ) ) {
+			cpumask_and( &pl->data_cpus, &pl->fixed_data_cpus, cpu_online_mask ) ;
+		}
+		else {
+			entl_placement_candidates( pl->node, cand ) ;
+			cpumask_andnot( &pl->data_cpus, cand, taken ) ;
+		}
+		if( cpumask_empty( &pl->data_cpus ) ) cpumask_copy( &pl->data_cpus, cpumask_of( pl->token_cpu ) ) ;
+	}
+
+	list_for_each_entry( pl, &entl_placement_ports, list ) pl->apply( pl ) ;
+}
+
+void entl_placement_add( entl_placement_t *pl )
+{
+	mutex_lock( &entl_placement_lock ) ;
+	list_add_tail( &pl->list, &entl_placement_ports ) ;
+	entl_placement_layout() ;
+	mutex_unlock( &entl_placement_lock ) ;
+}
+
+void entl_placement_remove( entl_placement_t *pl )
+{
+	mutex_lock( &entl_placement_lock ) ;
+	list_del( &pl->list ) ;
+	pl->token_cpu = -1 ;
+	cpumask_clear( &pl->data_cpus ) ;
+	pl->apply( pl ) ;
+	entl_placement_layout() ;
+	mutex_unlock( &entl_placement_lock ) ;
+}
+
+int entl_placement_set_token_cpu( entl_placement_t *pl, int cpu )
+{
+	if( cpu < -1 || cpu >= (int)nr_cpu_ids || (cpu >= 0 && !cpu_online( cpu )) ) return -EINVAL ;
+
+	mutex_lock( &entl_placement_lock ) ;
+	pl->fixed_token_cpu = cpu ;
+	entl_placement_layout() ;
+	mutex_unlock( &entl_placement_lock ) ;
+	return 0 ;
+}
+
+int entl_placement_set_data_cpus( entl_placement_t *pl, const struct cpumask *mask )
+{
+	if( !cpumask_empty( mask ) && !cpumask_intersects( mask, cpu_online_mask ) ) return -EINVAL ;
+
+	mutex_lock( &entl_placement_lock ) ;
+	cpumask_copy( &pl->fixed_data_cpus, mask ) ;
+	entl_placement_layout() ;
+	mutex_unlock( &entl_placement_lock ) ;
+	return 0 ;
+}
+
+ssize_t entl_placement_show( char *buf, size_t size )
+{
+	entl_placement_t *pl ;
+	ssize_t len = 0 ;
+
+	mutex_lock( &entl_placement_lock ) ;
+	list_for_each_entry( pl, &entl_placement_ports, list ) {
+		len += scnprintf( buf + len, size - len, "%s node %d token %d%s data %*pbl%s\n", pl->name, pl->node,
+				  pl->token_cpu, pl->fixed_token_cpu >= 0 ? " fixed" : "",
+				  cpumask_pr_args( &pl->data_cpus ), cpumask_empty( &pl->fixed_data_cpus ) ? "" : " fixed" ) ;
+	}
+	mutex_unlock( &entl_placement_lock ) ;
+	return len ;
+}
@@ -0,0 +1,41 @@
+/*
+ * ENTL cpu placement of the ports
+ * Copyright(c) 2016 Earth Computing.
+ *
+ */
+#ifndef _ENTL_PLACEMENT_H_
+#define _ENTL_PLACEMENT_H_
+
+#include <linux/list.h>
+#include <linux/cpumask.h>
+
+/// The placement of one port. Each port gets a core of its own for the token handling (the interrupts,
+///   the busy poll thread and the watchdog work) and the data cpus for RPS of the frames going up.
+///   The layout spreads the ports over the cpus of their node, cpu 0 is left for the rest of the system
+typedef struct entl_placement {
+	struct list_head list ;
+	const char *name ;                    // port name for the layout listing
+	int node ;                            // NUMA node of the port
+	int fixed_token_cpu ;                 // set by the user, -1 for the layout to choose
+	struct cpumask fixed_data_cpus ;      // set by the user, empty for the layout to choose
+	int token_cpu ;                       // current core for the token handling, -1 when not placed
+	struct cpumask data_cpus ;            // current RPS cpus for the data frames, empty when not placed
+	void (*apply)( struct entl_placement *pl ) ;  // move the port to token_cpu and data_cpus, may sleep
+} entl_placement_t ;
+
+/// add the port and lay all ports out again, apply is called for each port
+void entl_placement_add( entl_placement_t *pl ) ;
+
+/// take the port out, apply is called on it with nothing placed, then the rest is laid out again
+void entl_placement_remove( entl_placement_t *pl ) ;
+
+/// fix the token core of the port, -1 to have the layout choose it. -EINVAL if the cpu is not online
+int entl_placement_set_token_cpu( entl_placement_t *pl, int cpu ) ;
+
+/// fix the data cpus of the port, an empty mask to have the layout choose them
+int entl_placement_set_data_cpus( entl_placement_t *pl, const struct cpumask *mask ) ;
+
+/// print the layout of all ports, one line each, returns the length
+ssize_t entl_placement_show( char *buf, size_t size ) ;
+
+#endif
@@ -13,6 +13,7 @@ static int is_ENTT_queue_full( ENTT_queue_t* q ) ;
 static int push_back_ENTT_queue(ENTT_queue_t* q, void* dt ) ;
 static void* front_ENTT_queue(ENTT_queue_t* q ) ;
 static void* pop_front_ENTT_queue(ENTT_queue_t* q ) ;
+static void release_AIT_message( entl_state_machine_t *mcn, struct entt_ioctl_ait_data* data ) ;
 
 void entl_state_machine_init( entl_state_machine_t *mcn )
 {
@@ -48,6 +49,7 @@ void entl_state_machine_init( entl_state_machine_t *mcn )
   	mcn->receive_buffer = NULL ;
   	init_ENTT_queue( &mcn->send_ATI_queue ) ;
   	init_ENTT_queue( &mcn->receive_ATI_queue ) ;
+  	mcn->ait_release = NULL ;
 
 } 
 
@@ -84,6 +86,7 @@ static void set_error( entl_state_machine_t *mcn, __u32 error_flag )
   		mcn->error_state.p_error_flag |= error_flag ;
   	}
     mcn->error_state.error_count++ ;
+    if( error_flag == ENTL_ERROR_FLAG_SEQUENCE ) mcn->seq_errors++ ;
 
 }
 
@@ -507,7 +510,8 @@ int entl_received( entl_state_machine_t *mcn, __u16 u_saddr, __u32 l_saddr, __u1
 					retval = ENTL_ACTION_SEND | ENTL_ACTION_SIG_AIT ;
 					memcpy( &mcn->current_state.update_time, &ts, sizeof(struct timespec)) ;
 					ENTL_DEBUG( "%s ETL Ack %d received on Bh -> Send @ %ld sec\n", mcn->name, l_daddr, ts.tv_sec ) ;			
-					push_back_ENTT_queue( &mcn->receive_ATI_queue, mcn->receive_buffer ) ;
+					// no buffer when the driver consumed the AIT itself, nothing for the user then
+					if( mcn->receive_buffer ) push_back_ENTT_queue( &mcn->receive_ATI_queue, mcn->receive_buffer ) ;
 					mcn->receive_buffer = NULL ;
 				}
 				else {
@@ -759,7 +763,7 @@ int entl_next_send( entl_state_machine_t *mcn, __u16 *u_addr, __u32 *l_addr )
 			// drop the message on the top
 			ait_data = pop_front_ENTT_queue( &mcn->send_ATI_queue ) ;
 			if( ait_data ) {
-				kfree(ait_data) ;
+				release_AIT_message( mcn, ait_data ) ;
 			}
 			ENTL_DEBUG( "%s ETL AIT ACK %d requested on BM state -> Receive @ %ld sec\n", mcn->name, *l_addr, ts.tv_sec ) ;			
 		}
@@ -876,6 +880,7 @@ int entl_next_send_tx( entl_state_machine_t *mcn, __u16 *u_addr, __u32 *l_addr )
 		break ;
 		case ENTL_STATE_BM:
 		{
+			struct entt_ioctl_ait_data* ait_data ;
 			mcn->current_state.event_i_sent = mcn->current_state.event_send_next ;
 			mcn->current_state.event_send_next += 2 ;
 			*l_addr = mcn->current_state.event_i_sent ;
@@ -885,7 +890,10 @@ int entl_next_send_tx( entl_state_machine_t *mcn, __u16 *u_addr, __u32 *l_addr )
 			retval = ENTL_ACTION_SEND | ENTL_ACTION_SIG_AIT ;
 			mcn->current_state.current_state = ENTL_STATE_RECEIVE ;
 			// drop the message on the top
-			pop_front_ENTT_queue( &mcn->send_ATI_queue ) ;		
+			ait_data = pop_front_ENTT_queue( &mcn->send_ATI_queue ) ;
+			if( ait_data ) {
+				release_AIT_message( mcn, ait_data ) ;
+			}
 			ENTL_DEBUG( "%s ETL AIT ACK %d requested on BM state -> Receive @ %ld sec\n", mcn->name, *l_addr, ts.tv_sec ) ;			
 		}
 		break ;
@@ -1113,6 +1121,13 @@ u16 entl_num_queued( entl_state_machine_t *mcn )
 }
 
 
+// sent AIT message is done, give it back to whoever owns it
+static void release_AIT_message( entl_state_machine_t *mcn, struct entt_ioctl_ait_data* data ) 
+{
+	if( mcn->ait_release ) mcn->ait_release( mcn, data ) ;
+	else kfree( data ) ;
+}
+
 static void init_ENTT_queue( ENTT_queue_t* q ) 
 {
     q->size = MAX_ENTT_QUEUE_SIZE ;
@@ -76,12 +76,16 @@ typedef struct entl_state_machine {
   __u8 hello_addr_valid;        // valid flag for hello address
 
   __u32 state_count ;
+  __u32 seq_errors ;            // sequence errors, not cleared by entl_state_machine_init, for ethtool -S
 
   struct entt_ioctl_ait_data* receive_buffer ;
 
   ENTT_queue_t send_ATI_queue ;
   ENTT_queue_t receive_ATI_queue ;
 
+  // called with state_lock held when a sent AIT message is acknowledged, NULL to kfree it
+  void (*ait_release)( struct entl_state_machine *mcn, struct entt_ioctl_ait_data* data ) ;
+
   char name[ENTL_DEVICE_NAME_LEN] ;
 
 } entl_state_machine_t ;
@@ -32,6 +32,12 @@
 #ifndef u32
 #define u32 unsigned int
 #endif
+
+// histogram of the time between received tokens (one round trip of the exchange)
+//   bucket i counts intervals in [2^(i+ENTL_RTT_HIST_SHIFT), 2^(i+ENTL_RTT_HIST_SHIFT+1)) nsec,
+//   the first and the last bucket also take everything below and above
+#define ENTL_RTT_HIST_SHIFT 8
+#define ENTL_RTT_HIST_BUCKETS 16
  
 // The data structre represents the internal state of ENTL
 typedef struct entl_state {
@@ -80,6 +86,14 @@ struct entl_ioctl_data {
   u32   ctrl ;
   u32   ims ;
   u32 num_queued ;                  // number of messages left unsent in send queue
+  u32 data_tokens ;                 // tokens which carried data, data_frames / data_tokens is the frames per token
+  u32 data_frames ;                 // data frames sent on those tokens
+  u32 rtt_hist[ENTL_RTT_HIST_BUCKETS] ;  // token round trip histogram
+  u32 busy_polls ;                  // number of busy poll periods
+  u32 hw_rtt_ns ;                   // token round trip between the wire timestamps, 0 without hardware timestamps
+  u32 hw_one_way_ns ;               // one-way wire delay, the round trip less the peer turnaround over 2
+  u32 entangles ;                   // link ups which reached SEND
+  u32 entangle_ns ;                 // link up to the first SEND, last time
 };
 
 /* This structure is used in all of SIOCDEVPRIVATE_ENTT_xxx ioctl calls */
@@ -92,6 +106,88 @@ struct entt_ioctl_ait_data {
   u32 num_queued ;                  // number of messages left unsent in send queue
 };
 
+// ALO (atomic link operation) registers, executed by the port driver of the peer.
+//   An AIT message whose data starts with entl_alo_op_t is not delivered to the peer user, its driver runs the
+//   operation when the AIT arrives and returns entl_alo_result_t in the Ack, where SIOCDEVPRIVATE_ENTL_ALO_RESULT
+//   picks it up. The register file has the layout of ec_alo_regs_t of the ecnl driver
+#define SIOCDEVPRIVATE_ENTL_ALO_READ_REGS  0x89F9
+#define SIOCDEVPRIVATE_ENTL_ALO_WRITE_REG  0x89FA
+#define SIOCDEVPRIVATE_ENTL_ALO_RESULT     0x89FB
+
+// Link down and up again through the driver link hooks, for the bring-up benchmark. The link down error
+//   is cleared by the driver as the flap is on purpose, entangles and entangle_ns of RD_CURRENT tell the result
+#define SIOCDEVPRIVATE_ENTL_FLAP           0x89FC
+
+#define ENTL_ALO_NUM_REGS 32
+#define ENTL_ALO_MAGIC 0x314f4c41         // "ALO1"
+
+#define ENTL_ALO_READ   0                 // value = reg
+#define ENTL_ALO_WRITE  1                 // value = reg, reg = operand
+#define ENTL_ALO_ADD    2                 // value = reg, reg += operand
+#define ENTL_ALO_CAS    3                 // value = reg, reg = operand if reg == compare
+#define ENTL_ALO_SWAP   4                 // value = reg, reg = operand, same as WRITE but meant for the old value
+
+#define ENTL_ALO_STATUS_OK       0
+#define ENTL_ALO_STATUS_INVALID  1        // bad register index or operation
+#define ENTL_ALO_STATUS_MISMATCH 2        // CAS compare failed, value has the current register
+
+typedef struct entl_alo_regs {
+  uint64_t regs[ENTL_ALO_NUM_REGS] ;
+  uint32_t flags ;                  // bit n: register n changed by the peer since the last read, cleared by the read
+} entl_alo_regs_t ;
+
+typedef struct entl_alo_reg {
+  u32 index ;
+  uint64_t reg ;
+} entl_alo_reg_t ;
+
+typedef struct entl_alo_op {
+  u32 magic ;                       // ENTL_ALO_MAGIC
+  u32 op ;                          // ENTL_ALO_xxx
+  u32 index ;                       // register number
+  u32 seq ;                         // echoed in the result, the same seq, op and index as the last op is a resend, not run again
+  uint64_t operand ;
+  uint64_t compare ;                // CAS only
+} entl_alo_op_t ;
+
+typedef struct entl_alo_result {
+  u32 magic ;                       // ENTL_ALO_MAGIC
+  u32 op ;
+  u32 index ;
+  u32 seq ;
+  uint64_t value ;                  // the register before the operation
+  u32 status ;                      // ENTL_ALO_STATUS_xxx
+  u32 count ;                       // results received so far on the port, filled by SIOCDEVPRIVATE_ENTL_ALO_RESULT
+} entl_alo_result_t ;
+
+// ENTT shared-memory AIT rings
+//   SIOCDEVPRIVATE_ENTT_RING_SETUP creates /dev/entt_<ifname>. mmap() it to get struct entt_ait_ring_map.
+//   The send ring is produced by the user and consumed by the driver, the recv ring the other way round.
+//   head/tail are free running counters, the slot is (index & (ENTT_RING_SIZE-1)).
+//   The user only needs SIOCDEVPRIVATE_ENTT_RING_DOORBELL when the driver has set ENTT_RING_F_NEED_WAKEUP
+//   on the send ring (it drained the ring) or on the recv ring (it found the ring full, ring it after reaping),
+//   and poll() on the device only when the recv ring is empty.
+#define SIOCDEVPRIVATE_ENTT_RING_SETUP     0x89F7
+#define SIOCDEVPRIVATE_ENTT_RING_DOORBELL  0x89F8
+
+#define ENTT_RING_SIZE 64                 // must be power of 2
+#define ENTT_RING_DEV_PREFIX "entt_"
+
+#define ENTT_RING_F_NEED_WAKEUP 0x0001    // send: the driver is idle, ring the doorbell after posting. recv: the driver has more, ring it after reaping
+
+typedef struct entt_ring_ctl {
+  u32 head ;                        // consumer index
+  u32 tail ;                        // producer index
+  u32 flags ;                       // written by the driver only
+  u32 reserved ;
+} __attribute__((aligned(64))) entt_ring_ctl_t ;
+
+struct entt_ait_ring_map {
+  entt_ring_ctl_t send ;
+  entt_ring_ctl_t recv ;
+  struct entt_ioctl_ait_data send_ring[ENTT_RING_SIZE] ;
+  struct entt_ioctl_ait_data recv_ring[ENTT_RING_SIZE] ;
+};
 
 #endif
 
@@ -151,6 +151,79 @@ static const struct e1000_stats e1000_gstrings_stats[] = {
 #ifdef HAVE_HW_TIME_STAMP
 	E1000_STAT("tx_hwtstamp_timeouts", tx_hwtstamp_timeouts),
 #endif
+	/* ENTL link protocol */
+	E1000_STAT("entl_tokens_sent", entl_dev.stats.tokens_sent),
+	E1000_STAT("entl_tokens_received", entl_dev.link.stats.tokens_received),
+	E1000_STAT("entl_data_tokens", entl_dev.link.data_tokens),
+	E1000_STAT("entl_data_frames", entl_dev.link.data_frames),
+	E1000_STAT("entl_ait_sent", entl_dev.stats.ait_sent),
+	E1000_STAT("entl_ait_received", entl_dev.link.stats.ait_received),
+	E1000_STAT("entl_inject_busy", entl_dev.stats.inject_busy),
+	E1000_STAT("entl_inject_nomem", entl_dev.stats.inject_nomem),
+	E1000_STAT("entl_inject_dma_failed", entl_dev.stats.inject_dma_err),
+	E1000_STAT("entl_retries", entl_dev.link.stats.retries),
+	E1000_STAT("entl_tx_queue_stops", entl_dev.stats.tx_queue_stops),
+	E1000_STAT("entl_tx_bypass_busy", entl_dev.stats.tx_bypass_busy),
+	E1000_STAT("entl_seq_errors", entl_dev.link.stm.seq_errors),
+	E1000_STAT("entl_hello_restarts", entl_dev.link.stats.hello_restarts),
+	E1000_STAT("entl_hello_timeouts", entl_dev.link.stats.hello_timeouts),
+	E1000_STAT("entl_busy_polls", entl_dev.busy_polls),
+	E1000_STAT("entl_hw_rtt_ns", entl_dev.hw_rtt_ns),
+	E1000_STAT("entl_hw_one_way_ns", entl_dev.hw_one_way_ns),
+	E1000_STAT("entl_tx_control_frames", entl_dev.stats.tx_class[ENTL_TX_CLASS_CONTROL].frames),
+	E1000_STAT("entl_tx_control_wait_ns", entl_dev.stats.tx_class[ENTL_TX_CLASS_CONTROL].wait_ns),
+	E1000_STAT("entl_tx_control_max_wait_ns", entl_dev.stats.tx_class[ENTL_TX_CLASS_CONTROL].max_wait_ns),
+	E1000_STAT("entl_tx_control_depth", entl_dev.stats.tx_class[ENTL_TX_CLASS_CONTROL].depth),
+	E1000_STAT("entl_tx_control_max_depth", entl_dev.stats.tx_class[ENTL_TX_CLASS_CONTROL].max_depth),
+	E1000_STAT("entl_tx_control_bypass_frames", entl_dev.stats.tx_class[ENTL_TX_CLASS_CONTROL].bypass_frames),
+	E1000_STAT("entl_tx_control_bypass_bytes", entl_dev.stats.tx_class[ENTL_TX_CLASS_CONTROL].bypass_bytes),
+	E1000_STAT("entl_tx_normal_frames", entl_dev.stats.tx_class[ENTL_TX_CLASS_NORMAL].frames),
+	E1000_STAT("entl_tx_normal_wait_ns", entl_dev.stats.tx_class[ENTL_TX_CLASS_NORMAL].wait_ns),
+	E1000_STAT("entl_tx_normal_max_wait_ns", entl_dev.stats.tx_class[ENTL_TX_CLASS_NORMAL].max_wait_ns),
+	E1000_STAT("entl_tx_normal_depth", entl_dev.stats.tx_class[ENTL_TX_CLASS_NORMAL].depth),
+	E1000_STAT("entl_tx_normal_max_depth", entl_dev.stats.tx_class[ENTL_TX_CLASS_NORMAL].max_depth),
+	E1000_STAT("entl_tx_normal_bypass_frames", entl_dev.stats.tx_class[ENTL_TX_CLASS_NORMAL].bypass_frames),
+	E1000_STAT("entl_tx_normal_bypass_bytes", entl_dev.stats.tx_class[ENTL_TX_CLASS_NORMAL].bypass_bytes),
+	E1000_STAT("entl_tx_bulk_frames", entl_dev.stats.tx_class[ENTL_TX_CLASS_BULK].frames),
+	E1000_STAT("entl_tx_bulk_wait_ns", entl_dev.stats.tx_class[ENTL_TX_CLASS_BULK].wait_ns),
+	E1000_STAT("entl_tx_bulk_max_wait_ns", entl_dev.stats.tx_class[ENTL_TX_CLASS_BULK].max_wait_ns),
+	E1000_STAT("entl_tx_bulk_depth", entl_dev.stats.tx_class[ENTL_TX_CLASS_BULK].depth),
+	E1000_STAT("entl_tx_bulk_max_depth", entl_dev.stats.tx_class[ENTL_TX_CLASS_BULK].max_depth),
+	E1000_STAT("entl_tx_bulk_bypass_frames", entl_dev.stats.tx_class[ENTL_TX_CLASS_BULK].bypass_frames),
+	E1000_STAT("entl_tx_bulk_bypass_bytes", entl_dev.stats.tx_class[ENTL_TX_CLASS_BULK].bypass_bytes),
+	E1000_STAT("entl_rx_tokens_in_place", entl_dev.stats.rx_tokens_in_place),
+	E1000_STAT("entl_rx_page_reuse", entl_dev.stats.rx_page_reuse),
+	E1000_STAT("entl_rx_page_alloc", entl_dev.stats.rx_page_alloc),
+	E1000_STAT("entl_rx_copybreak", entl_dev.stats.rx_copybreak),
+	E1000_STAT("entl_rx_copybreak_bytes", entl_dev.stats.rx_copybreak_bytes),
+	E1000_STAT("entl_rx_drop_non_ec", entl_dev.stats.rx_drop_non_ec),
+	E1000_STAT("entl_alo_ops", entl_dev.stats.alo_ops),
+	E1000_STAT("entl_alo_results", entl_dev.stats.alo_results),
+	E1000_STAT("entl_rx_hook_batches", entl_dev.stats.rx_hook_batches),
+	E1000_STAT("entl_rx_hook_frames", entl_dev.stats.rx_hook_frames),
+	E1000_STAT("entl_rx_hook_host", entl_dev.stats.rx_hook_host),
+	E1000_STAT("entl_hellos_sent", entl_dev.link.stats.hellos_sent),
+	E1000_STAT("entl_entangles", entl_dev.link.stats.entangles),
+	E1000_STAT("entl_entangle_last_ns", entl_dev.link.stats.entangle_last_ns),
+	E1000_STAT("entl_entangle_max_ns", entl_dev.link.stats.entangle_max_ns),
+	E1000_STAT("entl_cycles_token", entl_dev.stats.cycles[ENTL_CYCLES_TOKEN].cycles),
+	E1000_STAT("entl_cycles_token_events", entl_dev.stats.cycles[ENTL_CYCLES_TOKEN].events),
+	E1000_STAT("entl_cycles_per_token", entl_dev.stats.cycles[ENTL_CYCLES_TOKEN].per_event),
+	E1000_STAT("entl_cycles_ait", entl_dev.stats.cycles[ENTL_CYCLES_AIT].cycles),
+	E1000_STAT("entl_cycles_ait_events", entl_dev.stats.cycles[ENTL_CYCLES_AIT].events),
+	E1000_STAT("entl_cycles_per_ait", entl_dev.stats.cycles[ENTL_CYCLES_AIT].per_event),
+	E1000_STAT("entl_cycles_rx_data", entl_dev.stats.cycles[ENTL_CYCLES_RX_DATA].cycles),
+	E1000_STAT("entl_cycles_rx_data_events", entl_dev.stats.cycles[ENTL_CYCLES_RX_DATA].events),
+	E1000_STAT("entl_cycles_per_rx_data", entl_dev.stats.cycles[ENTL_CYCLES_RX_DATA].per_event),
+	E1000_STAT("entl_cycles_tx_data", entl_dev.stats.cycles[ENTL_CYCLES_TX_DATA].cycles),
+	E1000_STAT("entl_cycles_tx_data_events", entl_dev.stats.cycles[ENTL_CYCLES_TX_DATA].events),
+	E1000_STAT("entl_cycles_per_tx_data", entl_dev.stats.cycles[ENTL_CYCLES_TX_DATA].per_event),
+	E1000_STAT("entl_cycles_inject", entl_dev.stats.cycles[ENTL_CYCLES_INJECT].cycles),
+	E1000_STAT("entl_cycles_inject_events", entl_dev.stats.cycles[ENTL_CYCLES_INJECT].events),
+	E1000_STAT("entl_cycles_per_inject", entl_dev.stats.cycles[ENTL_CYCLES_INJECT].per_event),
+	E1000_STAT("entl_cycles_watchdog", entl_dev.stats.cycles[ENTL_CYCLES_WATCHDOG].cycles),
+	E1000_STAT("entl_cycles_watchdog_events", entl_dev.stats.cycles[ENTL_CYCLES_WATCHDOG].events),
+	E1000_STAT("entl_cycles_per_watchdog", entl_dev.stats.cycles[ENTL_CYCLES_WATCHDOG].per_event),
 };
 
 #define E1000_GLOBAL_STATS_LEN	ARRAY_SIZE(e1000_gstrings_stats)
@@ -1100,27 +1100,24 @@ static bool e1000_clean_rx_irq(struct e1000_ring *rx_ring)
 		total_rx_packets++;
 
 		// AK: Process ENTL packet for RX data
-		if( adapter->entl_flag ) {
-			skb_put(skb, length);
-			if( !entl_device_process_rx_packet( &adapter->entl_dev, skb ) )
+		if( entl_port(adapter) ) {
+			// stray traffic is dropped from the buffer, before skb_put and the state machine
+			if( !entl_rx_frame_wanted( &adapter->entl_dev, skb->data, length ) ) {
+				buffer_info->skb = skb; // recycle
+				goto next_desc;
+			}
+			// processed from the buffer, skb_put is left to the delivery below
+			if( adapter->entl_dev.hwts_on ) entl_hwts_rx( adapter, staterr ) ;
+			if( !entl_device_process_rx( &adapter->entl_dev, skb->data, length ) )
 			{
 				// This packet is ENTL message only. Not forward to upper layer
 				buffer_info->skb = skb; // recycle
 				goto next_desc;
 			}	
-			else {
-				struct ethhdr *eth = (struct ethhdr *)skb->data ;
-				//ENTL_DEBUG("%s e1000_clean_rx_irq got message_len %d skb %p\n", netdev->name, length, skb );
-				if( eth->h_proto != ETH_P_ECLP && eth->h_proto != ETH_P_ECLD ) {
-					ENTL_DEBUG("%s e1000_clean_rx_irq dropping non EC type %4x %p len %d d: %02x %02x %02x %02x %02x %02x  %02x %02x %02x %02x %02x %02x  %02x%02x %02x %02x %02x %02x %02x %02x\n", netdev->name, eth->h_proto, skb, length,
-					  skb->data[0], skb->data[1], skb->data[2], skb->data[3], skb->data[4], skb->data[5], 
-					  skb->data[6], skb->data[7], skb->data[8], skb->data[9], skb->data[10], skb->data[11], 
-					  skb->data[12], skb->data[13],
-					  skb->data[14], skb->data[15], skb->data[16], skb->data[17], skb->data[18], skb->data[19]
-					  ) ;
-					buffer_info->skb = skb; // recycle
-					goto next_desc;
-				}
+			else if( ((struct ethhdr *)skb->data)->h_proto == 0 ) {
+				// token without the message only bit, nothing for the upper layer
+				buffer_info->skb = skb; // recycle
+				goto next_desc;
 			}
 		}
 
@@ -1128,7 +1125,8 @@ static bool e1000_clean_rx_irq(struct e1000_ring *rx_ring)
 		 * performance for small packets with large amounts
 		 * of reassembly being done in the stack
 		 */
-		if (length < copybreak) {
+		// AK: ENTL ports use their own threshold and count the hits
+		if (length < (entl_port(adapter) ? adapter->entl_dev.copybreak : copybreak)) {
 			struct sk_buff *new_skb =
 #ifdef CONFIG_E1000E_NAPI
 				napi_alloc_skb(&adapter->napi, length);
@@ -1145,6 +1143,11 @@ static bool e1000_clean_rx_irq(struct e1000_ring *rx_ring)
 				/* save the skb in buffer_info as good */
 				buffer_info->skb = skb;
 				skb = new_skb;
+				if (entl_port(adapter)) {
+					ENTL_STAT_INC(&adapter->entl_dev, rx_copybreak);
+					WRITE_ONCE(adapter->entl_dev.stats.rx_copybreak_bytes,
+						   adapter->entl_dev.stats.rx_copybreak_bytes + length);
+				}
 			}
 			/* else just continue with the old one */
 		}
@@ -1528,9 +1531,14 @@ static bool e1000_clean_rx_irq_ps(struct e1000_ring *rx_ring)
 			goto next_desc;
 		}
 
-		// AK: Process ENTL packet for RX data
-		if( adapter->entl_flag ) {
-			if( !entl_device_process_rx_packet( &adapter->entl_dev, skb ) )
+		// AK: Process ENTL packet for RX data, the header buffer holds length bytes
+		if( entl_port(adapter) ) {
+			if( !entl_rx_frame_wanted( &adapter->entl_dev, skb->data, length ) ) {
+				dev_kfree_skb_irq(skb);
+				goto next_desc;
+			}
+			if( adapter->entl_dev.hwts_on ) entl_hwts_rx( adapter, staterr ) ;
+			if( !entl_device_process_rx( &adapter->entl_dev, skb->data, length ) )
 			{
 				// This packet is ENTL message only. Not forward to upper layer
 				dev_kfree_skb_irq(skb);
@@ -1748,9 +1756,15 @@ static bool e1000_clean_jumbo_rx_irq(struct e1000_ring *rx_ring, int *work_done,
 			goto next_desc;
 		}
 
-		// AK: Process ENTL packet for RX data
-		if( adapter->entl_flag ) {
-			if( !entl_device_process_rx_packet( &adapter->entl_dev, skb ) )
+		// AK: Process ENTL packet for RX data, a single buffer frame is in the page
+		if( entl_port(adapter) && (staterr & E1000_RXD_STAT_EOP) && !rx_ring->rx_skb_top ) {
+			u8 *va = page_address( buffer_info->page ) ;
+			if( !entl_rx_frame_wanted( &adapter->entl_dev, va, length ) ) {
+				buffer_info->skb = skb; // recycle
+				goto next_desc;
+			}
+			if( adapter->entl_dev.hwts_on ) entl_hwts_rx( adapter, staterr ) ;
+			if( !entl_device_process_rx( &adapter->entl_dev, va, length ) )
 			{
 				// This packet is ENTL message only. Not forward to upper layer
 				buffer_info->skb = skb; // recycle
@@ -1898,7 +1912,8 @@ static void e1000_clean_rx_ring(struct e1000_ring *rx_ring)
 						 adapter->rx_buffer_len,
 						 DMA_FROM_DEVICE);
 #ifdef CONFIG_E1000E_NAPI
-			else if (adapter->clean_rx == e1000_clean_jumbo_rx_irq)
+			else if (adapter->clean_rx == e1000_clean_jumbo_rx_irq ||
+				 adapter->clean_rx == entl_clean_rx_irq)	// AK: ENTL keeps whole pages mapped
 				dma_unmap_page(pci_dev_to_dev(pdev),
 					       buffer_info->dma, PAGE_SIZE,
 					       DMA_FROM_DEVICE);
@@ -2452,7 +2467,7 @@ static int e1000_request_irq(struct e1000_adapter *adapter)
 	if (adapter->msix_entries) {
 		err = e1000_request_msix(adapter);
 		if (!err)
-			return err;
+			goto irq_done;
 		/* fall back to MSI */
 		e1000e_reset_interrupt_capability(adapter);
 		adapter->int_mode = E1000E_INT_MODE_MSI;
@@ -2462,7 +2477,7 @@ static int e1000_request_irq(struct e1000_adapter *adapter)
 		err = request_irq(adapter->pdev->irq, e1000_intr_msi, 0,
 				  netdev->name, netdev);
 		if (!err)
-			return err;
+			goto irq_done;
 
 		/* fall back to legacy interrupt */
 		e1000e_reset_interrupt_capability(adapter);
@@ -2471,16 +2486,25 @@ static int e1000_request_irq(struct e1000_adapter *adapter)
 
 	err = request_irq(adapter->pdev->irq, e1000_intr, IRQF_SHARED,
 			  netdev->name, netdev);
-	if (err)
+	if (err) {
 		e_err("Unable to allocate interrupt, Error: %d\n", err);
+		return err;
+	}
 
-	return err;
+irq_done:
+	// AK: ENTL low-latency profile keeps the port interrupts on one cpu
+	if (entl_port(adapter))
+		entl_lowlat_pin_irq(adapter);
+	return 0;
 }
 
 static void e1000_free_irq(struct e1000_adapter *adapter)
 {
 	struct net_device *netdev = adapter->netdev;
 
+	// AK: the affinity hint must be gone before free_irq
+	entl_lowlat_unpin_irq(adapter);
+
 	if (adapter->msix_entries) {
 		int vector = 0;
 
@@ -2720,6 +2744,9 @@ static void e1000_clean_tx_ring(struct e1000_ring *tx_ring)
 		e1000_put_txbuf(tx_ring, buffer_info);
 	}
 
+	// AK: the skbs waiting in the ENTL tx queue are charged to BQL too
+	entl_tx_queue_reset(&adapter->entl_dev, tx_ring->count);
+	entl_token_ring_reset(adapter);
 	netdev_reset_queue(adapter->netdev);
 	size = sizeof(struct e1000_buffer) * tx_ring->count;
 	memset(tx_ring->buffer_info, 0, size);
@@ -2846,6 +2873,12 @@ static void e1000_set_itr(struct e1000_adapter *adapter)
 	u16 current_itr;
 	u32 new_itr = adapter->itr;
 
+	// AK: ENTL ports are moderated on the token interval instead
+	if (entl_port(adapter)) {
+		entl_set_itr(adapter);
+		return;
+	}
+
 	/* for non-gigabit speeds, just fix the interrupt rate at 4000 */
 	if (adapter->link_speed != SPEED_1000) {
 		current_itr = 0;
@@ -2982,7 +3015,15 @@ static int e1000e_poll(struct napi_struct *napi, int weight)
 	    (adapter->rx_ring->ims_val & adapter->tx_ring->ims_val))
 		tx_cleaned = e1000_clean_tx_irq(adapter->tx_ring);
 
+	// AK: the ENTL responses of the whole poll share one tail update
+	if (entl_port(adapter))
+		entl_tx_batch_begin(&adapter->entl_dev);
 	adapter->clean_rx(adapter->rx_ring, &work_done, weight);
+	if (entl_port(adapter)) {
+		entl_tx_batch_end(&adapter->entl_dev);
+		if (work_done)
+			entl_busy_poll_kick(&adapter->entl_dev);
+	}
 
 	if (!tx_cleaned)
 		work_done = weight;
@@ -3928,7 +3969,7 @@ static void e1000e_set_rx_mode(struct net_device *netdev)
 	rctl &= ~(E1000_RCTL_UPE | E1000_RCTL_MPE);
 
 	// AK: ENTL mode always use promiscuous mode
-	if (adapter->entl_flag || netdev->flags & IFF_PROMISC) {
+	if (entl_port(adapter) || netdev->flags & IFF_PROMISC) {
 		rctl |= (E1000_RCTL_UPE | E1000_RCTL_MPE);
 #ifdef HAVE_VLAN_RX_REGISTER
 		rctl &= ~E1000_RCTL_VFE;
@@ -4710,9 +4751,11 @@ static void e1000e_trigger_lsc(struct e1000_adapter *adapter)
 void e1000e_up(struct e1000_adapter *adapter)
 {
 	/* hardware has been reset, we need to reload some things */
-	if (adapter->entl_flag)
+	if (entl_port(adapter))
 	{
 		ENTL_DEBUG("e1000e_up is called on %s, calling entl_e1000_configure\n", adapter->netdev->name );
+		// AK: the tx ring may have been resized while down
+		entl_tx_queue_reset( &adapter->entl_dev, adapter->tx_ring->count ) ;
 		entl_e1000_configure(adapter);
 		entl_device_link_up( &adapter->entl_dev ) ;
 	}
@@ -4778,9 +4821,11 @@ void e1000e_down(struct e1000_adapter *adapter, bool reset)
 
 	netif_carrier_off(netdev);
 
-	if (adapter->entl_flag)
+	if (entl_port(adapter))
 	{
 		ENTL_DEBUG("e1000e_down is called on %s, calling entl_device_link_down \n", adapter->netdev->name );
+		// AK: the busy poll thread may own the NAPI context
+		entl_busy_poll_stop( &adapter->entl_dev ) ;
 		entl_device_link_down( &adapter->entl_dev ) ;
 	}
 
@@ -5135,6 +5180,10 @@ static int e1000_open(struct net_device *netdev)
 	if (err)
 		goto err_setup_tx;
 
+	// AK: tokens on the second tx queue where the MAC has one
+	if (entl_port(adapter))
+		entl_token_ring_setup(adapter);
+
 	/* allocate receive descriptors */
 	err = e1000e_setup_rx_resources(adapter->rx_ring);
 	if (err)
@@ -5173,8 +5222,10 @@ static int e1000_open(struct net_device *netdev)
 	 * as soon as we call pci_request_irq, so we have to setup our
 	 * clean_rx handler before we do so.
 	 */
-	if (adapter->entl_flag)
+	if (entl_port(adapter))
 	{
+		// AK: the tx ring may have been resized while closed
+		entl_tx_queue_reset( &adapter->entl_dev, adapter->tx_ring->count ) ;
 		entl_e1000_configure(adapter);
 	}
 	else {
@@ -5229,6 +5280,7 @@ err_req_irq:
 	e1000_power_down_phy(adapter);
 	e1000e_free_rx_resources(adapter->rx_ring);
 err_setup_rx:
+	entl_token_ring_free(adapter);
 	e1000e_free_tx_resources(adapter->tx_ring);
 err_setup_tx:
 	e1000e_reset(adapter);
@@ -5274,6 +5326,7 @@ static int e1000_close(struct net_device *netdev)
 	napi_disable(&adapter->napi);
 #endif /* CONFIG_E1000E_NAPI */
 
+	entl_token_ring_free(adapter);
 	e1000e_free_tx_resources(adapter->tx_ring);
 	e1000e_free_rx_resources(adapter->rx_ring);
 
@@ -5304,6 +5357,9 @@ static int e1000_close(struct net_device *netdev)
 	    !test_bit(__E1000_TESTING, &adapter->state))
 		e1000e_release_hw_control(adapter);
 
+	// AK: the port leaves ENTL operation, give the platform settings back
+	entl_lowlat_restore(adapter);
+
 #ifdef HAVE_PM_QOS_REQUEST_LIST_NEW
 	pm_qos_remove_request(&adapter->pm_qos_req);
 #elif defined(HAVE_PM_QOS_REQUEST_LIST)
@@ -5494,6 +5550,12 @@ void e1000e_update_stats(struct e1000_adapter *adapter)
 	struct pci_dev *pdev = adapter->pdev;
 #endif
 
+	// AK: the ENTL tx class depths are read from the queues, not the hardware
+	if (entl_port(adapter)) {
+		entl_tx_class_depth(&adapter->entl_dev);
+		entl_cycles_update(&adapter->entl_dev);
+	}
+
 	/* Prevent stats update while adapter is being reset, or if the pci
 	 * connection is down.
 	 */
@@ -5933,7 +5995,7 @@ static void e1000_watchdog_task(struct work_struct *work)
 			netif_carrier_on(netdev);
 
 			// AK: tell ENTL state machine 
-			if (adapter->entl_flag)
+			if (entl_port(adapter))
 			{
 				ENTL_DEBUG( "%s e1000_watchdog_task calling entl_device_link_up\n", adapter->netdev->name ) ;
 				entl_device_link_up( &adapter->entl_dev ) ;
@@ -5955,7 +6017,7 @@ static void e1000_watchdog_task(struct work_struct *work)
 					  round_jiffies(jiffies + 2 * HZ));
 
 			// AK: tell ENTL state machine 
-			if (adapter->entl_flag)
+			if (entl_port(adapter))
 			{
 	    		ENTL_DEBUG( "%s e1000_watchdog_task calling entl_device_link_down\n", adapter->netdev->name ) ;
 				entl_device_link_down( &adapter->entl_dev ) ;
@@ -6323,6 +6385,18 @@ dma_error:
 	return 0;
 }
 
+/* AK: while ENTL works through a NAPI batch the tail update is deferred and
+ * entl_tx_batch_end() writes it once at the end of the poll.
+ * Called with tx_ring_lock held in ENTL mode.
+ */
+static bool e1000_tx_tail_deferred(struct e1000_adapter *adapter)
+{
+	if (!adapter->entl_dev.tx_batch)
+		return false;
+	adapter->entl_dev.tx_pending = 1;
+	return true;
+}
+
 static void e1000_tx_queue(struct e1000_ring *tx_ring, int tx_flags, int count)
 {
 	struct e1000_adapter *adapter = tx_ring->adapter;
@@ -6390,6 +6464,8 @@ static void e1000_tx_queue(struct e1000_ring *tx_ring, int tx_flags, int count)
 
 	tx_ring->next_to_use = i;
 #ifndef	HAVE_SKB_XMIT_MORE
+	if (e1000_tx_tail_deferred(adapter))
+		return;
 	if (adapter->flags2 & FLAG2_PCIM2PCI_ARBITER_WA)
 		e1000e_update_tdt_wa(tx_ring, i);
 	else
@@ -6470,6 +6546,20 @@ static int e1000_maybe_stop_tx(struct e1000_ring *tx_ring, int size)
 	return __e1000_maybe_stop_tx(tx_ring, size);
 }
 
+/* AK: with ENTL_TX_ON_ENTL_ENABLE the bytes of an ENTL port are charged to
+ * BQL when the skb enters the ENTL tx queue, so give them back when the skb
+ * is dropped here. A plain port charges them only once the skb is mapped.
+ */
+static void e1000_tx_drop(struct net_device *netdev, struct sk_buff *skb,
+			  bool entl)
+{
+#ifdef ENTL_TX_ON_ENTL_ENABLE
+	if (entl)
+		netdev_completed_queue(netdev, 1, skb->len);
+#endif
+	dev_kfree_skb_any(skb);
+}
+
 static netdev_tx_t e1000_xmit_frame(struct sk_buff *skb,
 				    struct net_device *netdev)
 {
@@ -6485,14 +6575,16 @@ static netdev_tx_t e1000_xmit_frame(struct sk_buff *skb,
 	unsigned int f;
 	__be16 protocol = vlan_get_protocol(skb);
 	unsigned long flags;
+	// AK: read once, the lock and the unlock below must agree
+	bool entl = entl_port(adapter);
 
 	if (test_bit(__E1000_DOWN, &adapter->state)) {
-		dev_kfree_skb_any(skb);
+		e1000_tx_drop(netdev, skb, entl);
 		return NETDEV_TX_OK;
 	}
 
 	if (skb->len <= 0) {
-		dev_kfree_skb_any(skb);
+		e1000_tx_drop(netdev, skb, entl);
 		return NETDEV_TX_OK;
 	}
 
@@ -6502,7 +6594,7 @@ static netdev_tx_t e1000_xmit_frame(struct sk_buff *skb,
 	if (skb_put_padto(skb, 17))
 		return NETDEV_TX_OK;
 
-	if (adapter->entl_flag)
+	if (entl)
 	{
 		// AK: packet modification for ENTL connection
 		entl_device_process_tx_packet( &adapter->entl_dev, skb ) ;
@@ -6527,7 +6619,7 @@ static netdev_tx_t e1000_xmit_frame(struct sk_buff *skb,
 			pull_size = min_t(unsigned int, 4, skb->data_len);
 			if (!__pskb_pull_tail(skb, pull_size)) {
 				e_err("__pskb_pull_tail failed.\n");
-				dev_kfree_skb_any(skb);
+				e1000_tx_drop(netdev, skb, entl);
 				return NETDEV_TX_OK;
 			}
 			len = skb_headlen(skb);
@@ -6555,22 +6647,15 @@ static netdev_tx_t e1000_xmit_frame(struct sk_buff *skb,
 	if (adapter->hw.mac.tx_pkt_filtering)
 		e1000_transfer_dhcp_info(adapter, skb);
 
-#ifndef ENTL_TX_ON_ENTL_ENABLE
-	// flow control is done on tx queue side when TX_ON_ENTL_ENABLE
-
 	/* need: count + 2 desc gap to keep tail from touching
 	 * head, otherwise try next time
 	 */
-	if (e1000_maybe_stop_tx(tx_ring, count + 2)) {
-		if (adapter->entl_flag)
-		{
-			// AK: don't forget to unlock before returning
-	    	spin_unlock_irqrestore( &adapter->tx_ring_lock, flags ) ;    	
-	   	}		
-		return NETDEV_TX_BUSY;
-	}
-
+#ifdef ENTL_TX_ON_ENTL_ENABLE
+	// AK: flow control of an ENTL port is done on the ENTL tx queue side
+	if (!entl)
 #endif
+	if (e1000_maybe_stop_tx(tx_ring, count + 2))
+		return NETDEV_TX_BUSY;
 
 #if defined(NETIF_F_HW_VLAN_TX) || defined(NETIF_F_HW_VLAN_CTAG_TX)
 	if (skb_vlan_tag_present(skb)) {
@@ -6581,7 +6666,7 @@ static netdev_tx_t e1000_xmit_frame(struct sk_buff *skb,
 #endif
 
 	// AK: use spin_lock to protext tx_ring. (assuming this is not on ISR context)
-	if (adapter->entl_flag)
+	if (entl)
 	{
 		spin_lock_irqsave( &adapter->tx_ring_lock, flags ) ;	
 	}
@@ -6590,7 +6675,9 @@ static netdev_tx_t e1000_xmit_frame(struct sk_buff *skb,
 
 	tso = e1000_tso(tx_ring, skb, protocol);
 	if (tso < 0) {
-		dev_kfree_skb_any(skb);
+		e1000_tx_drop(netdev, skb, entl);
+		if (entl)
+			spin_unlock_irqrestore( &adapter->tx_ring_lock, flags ) ;
 		return NETDEV_TX_OK;
 	}
 
@@ -6646,6 +6733,10 @@ static netdev_tx_t e1000_xmit_frame(struct sk_buff *skb,
 		skb_tx_timestamp(skb);
 #endif /* HAVE_HW_TIME_STAMP */
 
+#ifdef ENTL_TX_ON_ENTL_ENABLE
+		// AK: an ENTL port charged it in entl_tx_transmit
+		if (!entl)
+#endif
 		netdev_sent_queue(netdev, skb->len);
 		e1000_tx_queue(tx_ring, tx_flags, count);
 		/* Make sure there is space in the ring for the next send. */
@@ -6655,8 +6746,9 @@ static netdev_tx_t e1000_xmit_frame(struct sk_buff *skb,
 						  adapter->tx_fifo_limit) + 2));
 
 #ifdef HAVE_SKB_XMIT_MORE
-		if (!skb->xmit_more ||
-		    netif_xmit_stopped(netdev_get_tx_queue(netdev, 0))) {
+		if (!e1000_tx_tail_deferred(adapter) &&
+		    (!skb->xmit_more ||
+		     netif_xmit_stopped(netdev_get_tx_queue(netdev, 0)))) {
 			if (adapter->flags2 & FLAG2_PCIM2PCI_ARBITER_WA)
 				e1000e_update_tdt_wa(tx_ring,
 						     tx_ring->next_to_use);
@@ -6671,13 +6763,13 @@ static netdev_tx_t e1000_xmit_frame(struct sk_buff *skb,
 		}
 #endif
 	} else {
-		dev_kfree_skb_any(skb);
+		e1000_tx_drop(netdev, skb, entl);
 		tx_ring->buffer_info[first].time_stamp = 0;
 		tx_ring->next_to_use = first;
 	}
 	netdev->trans_start = jiffies;
 
-	if (adapter->entl_flag)
+	if (entl)
 	{
 		// AK: don't forget to unlock before returning
     	spin_unlock_irqrestore( &adapter->tx_ring_lock, flags ) ;    	
@@ -7039,6 +7131,12 @@ static int e1000_ioctl(struct net_device *netdev, struct ifreq *ifr, int cmd)
 	case SIOCDEVPRIVATE_ENTL_DO_INIT:
 	case SIOCDEVPRIVATE_ENTT_SEND_AIT:
 	case SIOCDEVPRIVATE_ENTT_READ_AIT:
+	case SIOCDEVPRIVATE_ENTT_RING_SETUP:
+	case SIOCDEVPRIVATE_ENTT_RING_DOORBELL:
+	case SIOCDEVPRIVATE_ENTL_ALO_READ_REGS:
+	case SIOCDEVPRIVATE_ENTL_ALO_WRITE_REG:
+	case SIOCDEVPRIVATE_ENTL_ALO_RESULT:
+	case SIOCDEVPRIVATE_ENTL_FLAP:
 		return entl_do_ioctl(netdev, ifr, cmd);		
 	default:
 		return -EOPNOTSUPP;
@@ -8169,8 +8267,6 @@ static int e1000_probe(struct pci_dev *pdev, const struct pci_device_id *ent)
 	spin_lock_init( &adapter->tx_ring_lock ) ;
 	// AK: initialize entl device
 	entl_device_init( &adapter->entl_dev ) ;
-	// AK: default, entl mode is enabled 
-	adapter->entl_flag = 1 ;
 
 	mmio_start = pci_resource_start(pdev, 0);
 	mmio_len = pci_resource_len(pdev, 0);
@@ -8487,6 +8583,14 @@ static int e1000_probe(struct pci_dev *pdev, const struct pci_device_id *ent)
 	if (!(adapter->flags & FLAG_HAS_AMT))
 		e1000e_get_hw_control(adapter);
 
+	// AK: ENTL mode is on by default, EntlMode turns it off per port
+	if (adapter->entl_dev.port_enable)
+		entl_port_enable(adapter);
+
+	// AK: the placement files are registered with the device
+	if (entl_port(adapter))
+		entl_placement_sysfs(adapter);
+
 	strlcpy(netdev->name, "eth%d", sizeof(netdev->name));
 	err = register_netdev(netdev);
 	if (err)
@@ -8495,6 +8599,10 @@ static int e1000_probe(struct pci_dev *pdev, const struct pci_device_id *ent)
 	/* carrier off reporting is important to ethtool even BEFORE open */
 	netif_carrier_off(netdev);
 
+	// AK: spread the ENTL ports over the cpus, the port needs its name for this
+	if (entl_port(adapter))
+		entl_placement_start(adapter);
+
 	/* init PTP hardware clock */
 	e1000e_ptp_init(adapter);
 
@@ -8506,6 +8614,7 @@ static int e1000_probe(struct pci_dev *pdev, const struct pci_device_id *ent)
 	return 0;
 
 err_register:
+	entl_port_disable(adapter);
 	if (!(adapter->flags & FLAG_HAS_AMT))
 		e1000e_release_hw_control(adapter);
 err_eeprom:
@@ -8521,6 +8630,8 @@ err_sw_init:
 err_flashmap:
 	iounmap(adapter->hw.hw_addr);
 err_ioremap:
+	// AK: release what entl_device_init allocated
+	entl_device_stop(&adapter->entl_dev);
 	free_netdev(netdev);
 err_alloc_etherdev:
 	pci_release_selected_regions(pdev,
@@ -8582,7 +8693,12 @@ static void e1000_remove(struct pci_dev *pdev)
 	/* Don't lie to e1000_close() down the road. */
 	if (!down)
 		clear_bit(__E1000_DOWN, &adapter->state);
+	entl_placement_stop(adapter);
 	unregister_netdev(netdev);
+	entl_port_disable(adapter);
+
+	// AK: stop the ENTL watchdog and release the AIT rings
+	entl_device_stop( &adapter->entl_dev ) ;
 
 	if (pci_dev_run_wake(pdev))
 		pm_runtime_get_noresume(pci_dev_to_dev(pdev));
@@ -182,6 +182,150 @@ E1000_PARAM(EEE, "Enable/disable on parts that support the feature");
  */
 E1000_PARAM(Node, "[ROUTING] Node to allocate memory on, default -1");
 
+/* ENTL data burst, frames sent per received token. The first frame carries
+ * the token and the rest go out as NOP frames before the next token.
+ *
+ * Valid Range: 1-256
+ *
+ * Default Value: 1
+ */
+E1000_PARAM(EntlBurstFrames, "ENTL data frames sent per token");
+#define DEFAULT_ENTL_BURST_FRAMES 1
+#define MAX_ENTL_BURST_FRAMES 256
+#define MIN_ENTL_BURST_FRAMES 1
+
+/* ENTL data burst, bytes sent per received token, the burst ends on
+ * whichever of EntlBurstFrames and EntlBurstBytes runs out first
+ *
+ * Valid Range: 0-1048576 (0=no byte limit)
+ *
+ * Default Value: 0
+ */
+E1000_PARAM(EntlBurstBytes, "ENTL data bytes sent per token, 0 for no limit");
+#define DEFAULT_ENTL_BURST_BYTES 0
+#define MAX_ENTL_BURST_BYTES 1048576
+#define MIN_ENTL_BURST_BYTES 0
+
+/* ENTL copybreak, ENTL data frames shorter than this are copied into a
+ * right-sized skb and the rx buffer goes straight back to the ring
+ *
+ * Valid Range: 0-2048 (0=never copy)
+ *
+ * Default Value: 256
+ */
+E1000_PARAM(EntlCopybreak, "ENTL rx copybreak threshold in bytes, 0 to disable");
+#define DEFAULT_ENTL_COPYBREAK 256
+#define MAX_ENTL_COPYBREAK 2048
+#define MIN_ENTL_COPYBREAK 0
+
+/* ENTL busy poll, cpu to pin a thread on which spins on the rx ring for
+ * the token exchange and falls back to interrupts when the link is idle
+ *
+ * Valid Range: 0 - number of cpus - 1
+ *
+ * Default Value: -1 (disabled)
+ */
+E1000_PARAM(EntlBusyPoll, "ENTL busy poll cpu, default -1 (disabled)");
+
+/* ENTL low-latency profile: hold a pm_qos cpu latency request, disable EEE
+ * and ASPM, and pin the port interrupts while the port runs ENTL
+ *
+ * Valid Range: 0, 1
+ *
+ * Default Value: 1 (enabled)
+ */
+E1000_PARAM(EntlLowLatency, "Enable/disable the ENTL low-latency profile");
+
+/* ENTL hardware timestamps: timestamp the token exchange with the PTP clock
+ * to measure the wire round trip and one-way delay. Takes over the MAC
+ * timestamp registers, so it does not go along with PTP on the same port.
+ *
+ * Valid Range: 0, 1
+ *
+ * Default Value: 0 (disabled)
+ */
+E1000_PARAM(EntlHwTstamp, "Enable/disable ENTL hardware timestamps");
+
+/* ENTL token queue: send the tokens and AIT frames on the second hardware
+ * tx queue of the 82574, so they don't wait behind the data frames.
+ * Other parts have one queue and ignore it.
+ *
+ * Valid Range: 0, 1
+ *
+ * Default Value: 1 (enabled)
+ */
+E1000_PARAM(EntlTokenQueue, "Enable/disable the ENTL token tx queue");
+
+/* ENTL mode: run the ENTL link protocol on the port. With it off the port
+ * is a plain e1000e port, and when no port runs ENTL the ENTL hooks in the
+ * driver are patched out.
+ *
+ * Valid Range: 0, 1
+ *
+ * Default Value: 1 (enabled)
+ */
+E1000_PARAM(EntlMode, "Enable/disable ENTL on the port");
+
+/* ENTL rx filter: turn off multicast and broadcast receive on the port.
+ * The ENTL addresses never have the group bit, so stray broadcast and
+ * multicast traffic is dropped by the MAC instead of the driver.
+ *
+ * Valid Range: 0, 1
+ *
+ * Default Value: 1 (enabled)
+ */
+E1000_PARAM(EntlRxFilter, "Enable/disable the ENTL group address rx filter");
+
+/* ENTL Hello retry: the Hello goes out from the link up and is sent again
+ * after this many ms while the link is not entangled, doubling every retry
+ * up to one second
+ *
+ * Valid Range: 1-1000
+ *
+ * Default Value: 2
+ */
+E1000_PARAM(EntlHelloMs, "ENTL first Hello retry after link up in ms");
+#define DEFAULT_ENTL_HELLO_MS 2
+#define MAX_ENTL_HELLO_MS 1000
+#define MIN_ENTL_HELLO_MS 1
+
+/* ENTL placement: give the port a cpu core of its own for the interrupts,
+ * the busy poll thread and the watchdog work, and set RPS of the data frames
+ * to the cpus the other ports leave. Changed at run time in
+ * /sys/class/net/<port>/entl.
+ *
+ * Valid Range: 0, 1
+ *
+ * Default Value: 1 (enabled)
+ */
+E1000_PARAM(EntlPlacement, "Enable/disable the ENTL cpu placement of the port");
+
+/* ENTL bypass EtherType: data frames of this EtherType go straight to the
+ * tx ring with a NOP address instead of waiting for a token, so they are
+ * not held to the token rate and lose the ENTL ordering. The peer port
+ * must have the same EtherType to receive them.
+ *
+ * Valid Range: 0-65535 (0=none)
+ *
+ * Default Value: 0
+ */
+E1000_PARAM(EntlBypassType, "ENTL EtherType sent without a token, 0 for none");
+#define DEFAULT_ENTL_BYPASS_TYPE 0
+#define MAX_ENTL_BYPASS_TYPE 0xFFFF
+#define MIN_ENTL_BYPASS_TYPE 0
+
+/* ENTL bypass priorities: bit n set sends the ECLP/ECLD frames with
+ * skb->priority n without a token, as EntlBypassType does
+ *
+ * Valid Range: 0-65535 (0=none)
+ *
+ * Default Value: 0
+ */
+E1000_PARAM(EntlBypassPrio, "ENTL skb priority bitmask sent without a token, 0 for none");
+#define DEFAULT_ENTL_BYPASS_PRIO 0
+#define MAX_ENTL_BYPASS_PRIO 0xFFFF
+#define MIN_ENTL_BYPASS_PRIO 0
+
 struct e1000_option {
 	enum { enable_option, range_option, list_option } type;
 	const char *name;
@@ -615,4 +759,243 @@ void e1000e_check_options(struct e1000_adapter *adapter)
 
 		adapter->node = node;
 	}
+	/* ENTL data burst credit */
+	{
+		static const struct e1000_option opt = {
+			.type = range_option,
+			.name = "ENTL Burst Frames",
+			.err  = "using default of "
+				__MODULE_STRING(DEFAULT_ENTL_BURST_FRAMES),
+			.def  = DEFAULT_ENTL_BURST_FRAMES,
+			.arg  = { .r = { .min = MIN_ENTL_BURST_FRAMES,
+					 .max = MAX_ENTL_BURST_FRAMES } }
+		};
+
+		if (num_EntlBurstFrames > bd) {
+			adapter->entl_dev.burst_frames = EntlBurstFrames[bd];
+			e1000_validate_option(&adapter->entl_dev.burst_frames,
+					      &opt, adapter);
+		} else {
+			adapter->entl_dev.burst_frames = opt.def;
+		}
+	}
+	{
+		static const struct e1000_option opt = {
+			.type = range_option,
+			.name = "ENTL Burst Bytes",
+			.err  = "using default of "
+				__MODULE_STRING(DEFAULT_ENTL_BURST_BYTES),
+			.def  = DEFAULT_ENTL_BURST_BYTES,
+			.arg  = { .r = { .min = MIN_ENTL_BURST_BYTES,
+					 .max = MAX_ENTL_BURST_BYTES } }
+		};
+
+		if (num_EntlBurstBytes > bd) {
+			adapter->entl_dev.burst_bytes = EntlBurstBytes[bd];
+			e1000_validate_option(&adapter->entl_dev.burst_bytes,
+					      &opt, adapter);
+		} else {
+			adapter->entl_dev.burst_bytes = opt.def;
+		}
+	}
+	/* ENTL copybreak */
+	{
+		static const struct e1000_option opt = {
+			.type = range_option,
+			.name = "ENTL Copybreak",
+			.err  = "using default of "
+				__MODULE_STRING(DEFAULT_ENTL_COPYBREAK),
+			.def  = DEFAULT_ENTL_COPYBREAK,
+			.arg  = { .r = { .min = MIN_ENTL_COPYBREAK,
+					 .max = MAX_ENTL_COPYBREAK } }
+		};
+
+		if (num_EntlCopybreak > bd) {
+			adapter->entl_dev.copybreak = EntlCopybreak[bd];
+			e1000_validate_option(&adapter->entl_dev.copybreak,
+					      &opt, adapter);
+		} else {
+			adapter->entl_dev.copybreak = opt.def;
+		}
+	}
+	/* ENTL busy poll */
+	{
+		static struct e1000_option opt = {
+			.type = range_option,
+			.name = "ENTL Busy Poll cpu",
+			.err  = "defaulting to -1 (disabled)",
+			.def  = -1,
+			.arg  = { .r = { .min = 0,
+					 .max = NR_CPUS - 1 } }
+		};
+		int cpu = opt.def;
+
+		if (num_EntlBusyPoll > bd) {
+			cpu = EntlBusyPoll[bd];
+			e1000_validate_option((unsigned int *)&cpu, &opt,
+					      adapter);
+		}
+		adapter->entl_dev.busy_poll_cpu = cpu;
+	}
+	/* ENTL low-latency profile */
+	{
+		static const struct e1000_option opt = {
+			.type = enable_option,
+			.name = "ENTL Low Latency Profile",
+			.err  = "defaulting to Enabled",
+			.def  = OPTION_ENABLED
+		};
+
+		if (num_EntlLowLatency > bd) {
+			unsigned int lowlat = EntlLowLatency[bd];
+			e1000_validate_option(&lowlat, &opt, adapter);
+			adapter->entl_dev.lowlat = lowlat;
+		} else {
+			adapter->entl_dev.lowlat = opt.def;
+		}
+	}
+	/* ENTL hardware timestamps */
+	{
+		static const struct e1000_option opt = {
+			.type = enable_option,
+			.name = "ENTL Hardware Timestamps",
+			.err  = "defaulting to Disabled",
+			.def  = OPTION_DISABLED
+		};
+
+		if (num_EntlHwTstamp > bd) {
+			unsigned int hwts = EntlHwTstamp[bd];
+			e1000_validate_option(&hwts, &opt, adapter);
+			adapter->entl_dev.hwts = hwts;
+		} else {
+			adapter->entl_dev.hwts = opt.def;
+		}
+	}
+	/* ENTL token queue */
+	{
+		static const struct e1000_option opt = {
+			.type = enable_option,
+			.name = "ENTL Token Queue",
+			.err  = "defaulting to Enabled",
+			.def  = OPTION_ENABLED
+		};
+
+		if (num_EntlTokenQueue > bd) {
+			unsigned int token_queue = EntlTokenQueue[bd];
+			e1000_validate_option(&token_queue, &opt, adapter);
+			adapter->entl_dev.token_queue = token_queue;
+		} else {
+			adapter->entl_dev.token_queue = opt.def;
+		}
+	}
+	/* ENTL mode */
+	{
+		static const struct e1000_option opt = {
+			.type = enable_option,
+			.name = "ENTL Mode",
+			.err  = "defaulting to Enabled",
+			.def  = OPTION_ENABLED
+		};
+
+		if (num_EntlMode > bd) {
+			unsigned int port_enable = EntlMode[bd];
+			e1000_validate_option(&port_enable, &opt, adapter);
+			adapter->entl_dev.port_enable = port_enable;
+		} else {
+			adapter->entl_dev.port_enable = opt.def;
+		}
+	}
+	/* ENTL rx filter */
+	{
+		static const struct e1000_option opt = {
+			.type = enable_option,
+			.name = "ENTL Rx Filter",
+			.err  = "defaulting to Enabled",
+			.def  = OPTION_ENABLED
+		};
+
+		if (num_EntlRxFilter > bd) {
+			unsigned int rx_filter = EntlRxFilter[bd];
+			e1000_validate_option(&rx_filter, &opt, adapter);
+			adapter->entl_dev.rx_filter = rx_filter;
+		} else {
+			adapter->entl_dev.rx_filter = opt.def;
+		}
+	}
+	/* ENTL placement */
+	{
+		static const struct e1000_option opt = {
+			.type = enable_option,
+			.name = "ENTL Placement",
+			.err  = "defaulting to Enabled",
+			.def  = OPTION_ENABLED
+		};
+
+		if (num_EntlPlacement > bd) {
+			unsigned int placement_on = EntlPlacement[bd];
+			e1000_validate_option(&placement_on, &opt, adapter);
+			adapter->entl_dev.placement_on = placement_on;
+		} else {
+			adapter->entl_dev.placement_on = opt.def;
+		}
+	}
+	/* ENTL Hello retry */
+	{
+		static const struct e1000_option opt = {
+			.type = range_option,
+			.name = "ENTL Hello retry ms",
+			.err  = "using default of "
+				__MODULE_STRING(DEFAULT_ENTL_HELLO_MS),
+			.def  = DEFAULT_ENTL_HELLO_MS,
+			.arg  = { .r = { .min = MIN_ENTL_HELLO_MS,
+					 .max = MAX_ENTL_HELLO_MS } }
+		};
+
+		if (num_EntlHelloMs > bd) {
+			adapter->entl_dev.link.hello_ms = EntlHelloMs[bd];
+			e1000_validate_option(&adapter->entl_dev.link.hello_ms,
+					      &opt, adapter);
+		} else {
+			adapter->entl_dev.link.hello_ms = opt.def;
+		}
+	}
+	/* ENTL bypass */
+	{
+		static const struct e1000_option opt = {
+			.type = range_option,
+			.name = "ENTL Bypass EtherType",
+			.err  = "using default of "
+				__MODULE_STRING(DEFAULT_ENTL_BYPASS_TYPE),
+			.def  = DEFAULT_ENTL_BYPASS_TYPE,
+			.arg  = { .r = { .min = MIN_ENTL_BYPASS_TYPE,
+					 .max = MAX_ENTL_BYPASS_TYPE } }
+		};
+
+		if (num_EntlBypassType > bd) {
+			adapter->entl_dev.bypass_type = EntlBypassType[bd];
+			e1000_validate_option(&adapter->entl_dev.bypass_type,
+					      &opt, adapter);
+		} else {
+			adapter->entl_dev.bypass_type = opt.def;
+		}
+	}
+	{
+		static const struct e1000_option opt = {
+			.type = range_option,
+			.name = "ENTL Bypass Priorities",
+			.err  = "using default of "
+				__MODULE_STRING(DEFAULT_ENTL_BYPASS_PRIO),
+			.def  = DEFAULT_ENTL_BYPASS_PRIO,
+			.arg  = { .r = { .min = MIN_ENTL_BYPASS_PRIO,
+					 .max = MAX_ENTL_BYPASS_PRIO } }
+		};
+
+		if (num_EntlBypassPrio > bd) {
+			adapter->entl_dev.bypass_prio = EntlBypassPrio[bd];
+			e1000_validate_option(&adapter->entl_dev.bypass_prio,
+					      &opt, adapter);
+		} else {
+			adapter->entl_dev.bypass_prio = opt.def;
+		}
+	}
 }
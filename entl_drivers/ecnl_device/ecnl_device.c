@@ -783,6 +783,8 @@ static int ecnl_driver_index(unsigned char *ecnl_name) {
     return e_dev->index; // module_id
 }
 
+static void ecnl_rx_hook_receive(entl_rx_hook_t *hook, struct sk_buff_head *batch, struct sk_buff_head *host);
+
 static int ecnl_register_port(int module_id, unsigned char *name, struct net_device *e1000e, struct entl_driver_funcs *funcs) {
     struct net_device *plug_in = ecnl_devices[module_id];
     if (plug_in == NULL) {
@@ -805,15 +807,23 @@ static int ecnl_register_port(int module_id, unsigned char *name, struct net_dev
         ECNL_DEBUG("ecnl_register_port module-id %d port-name \"%s\" port-id %d\n", module_id, name, port_id);
         struct entl_driver *e_driver = &e_dev->drivers[port_id];
         e_driver->index = port_id; // port_id
+        e_driver->module_id = module_id;
         e_driver->name = name;
         e_driver->device = e1000e;
         e_driver->funcs = funcs;
+        e_driver->rx_hook.receive = ecnl_rx_hook_receive;
     }
     else {
         ECNL_DEBUG("ecnl_register_port module-id %d table overflow %d\n", module_id, e_dev->num_ports);
     }
     spin_unlock_irqrestore(&e_dev->drivers_lock, flags);
 
+    // the port's data frames come straight from its NAPI poll from now on
+    if (port_id >= 0 && e1000e) {
+        struct e1000_adapter *adapter = netdev_priv(e1000e);
+        entl_rx_hook_set(&adapter->entl_dev, &e_dev->drivers[port_id].rx_hook);
+    }
+
     return port_id;
 }
 
@@ -826,6 +836,15 @@ static void ecnl_deregister_ports(int module_id) {
 
     struct ecnl_device *e_dev = (struct ecnl_device *) netdev_priv(plug_in);
 
+    // back to the host stack, waits for the NAPI polls still in the hook
+    for (int i = 0; i < e_dev->num_ports; i++) {
+        struct net_device *e1000e = e_dev->drivers[i].device;
+        if (e1000e) {
+            struct e1000_adapter *adapter = netdev_priv(e1000e);
+            entl_rx_hook_set(&adapter->entl_dev, NULL);
+        }
+    }
+
     unsigned long flags;
     spin_lock_irqsave(&e_dev->drivers_lock, flags);
     e_dev->num_ports = 0;
@@ -881,10 +900,20 @@ static void set_next_id(struct sk_buff *skb, u32 nextID) {
     eth->h_source[5] = 0xff & (nextID);
 }
 
-static int ecnl_receive_skb(int module_id, int index, struct sk_buff *skb) {
+// frames for this host go on host when it's given, the rx hook delivers them with GRO from the NAPI poll.
+// Without it they go through netif_rx
+static void ecnl_to_host(struct sk_buff *skb, struct sk_buff_head *host) {
+    if (!skb) return;  // the clone failed
+    if (host) __skb_queue_tail(host, skb);
+    else netif_rx(skb);
+}
+
+// the skb is freed on the error returns
+static int ecnl_forward_skb(int module_id, int index, struct sk_buff *skb, struct sk_buff_head *host) {
     struct net_device *plug_in = ecnl_devices[module_id];
     if (plug_in == NULL) {
         ECNL_DEBUG("ecnl_receive_skb module-id %d not found\n", module_id);
+        kfree_skb(skb);
         return -EINVAL;
     }
 
@@ -893,14 +922,14 @@ static int ecnl_receive_skb(int module_id, int index, struct sk_buff *skb) {
     // no forwarding, send to host
     u8 dest_fw = eth->h_dest[0] & 0x80;
     if (dest_fw == 0) {
-        netif_rx(skb);
+        ecnl_to_host(skb, host);
         return 0;
     }
 
     // forwarding disabled, send to host
     struct ecnl_device *e_dev = (struct ecnl_device *) netdev_priv(plug_in);
     if (!e_dev->fw_enable) {
-        netif_rx(skb);
+        ecnl_to_host(skb, host);
         return 0;
     }
 
@@ -914,7 +943,7 @@ static int ecnl_receive_skb(int module_id, int index, struct sk_buff *skb) {
     // table miss, send to host
     if (!e_dev->current_table || id >= e_dev->current_table_size) {
         ECNL_DEBUG("ecnl_receive_skb module-id %d can't forward packet id %d\n", module_id, id);
-        netif_rx(skb);
+        ecnl_to_host(skb, host);
         return 0;
     }
 
@@ -928,6 +957,7 @@ static int ecnl_receive_skb(int module_id, int index, struct sk_buff *skb) {
     if (direction == 0) {  // forward direction
         if (port_vector == 0) {
             ECNL_DEBUG("ecnl_receive_skb no forward bit, module-id %d %08x\n", module_id, index);
+            kfree_skb(skb);
             return -EINVAL;
         }
 
@@ -935,9 +965,9 @@ static int ecnl_receive_skb(int module_id, int index, struct sk_buff *skb) {
         if (port_vector & 1) {
             if (port_vector & 0xfffe) {
                 struct sk_buff *skbc = skb_clone(skb, GFP_ATOMIC);
-                netif_rx(skbc);
+                ecnl_to_host(skbc, host);
             }
-            else netif_rx(skb);
+            else ecnl_to_host(skb, host);
         }
 
         // multi-port forwarding
@@ -976,9 +1006,9 @@ static int ecnl_receive_skb(int module_id, int index, struct sk_buff *skb) {
         if (parent == 0 || host_on_backward) {
             if (parent > 0) {
                 struct sk_buff *skbc = skb_clone(skb, GFP_ATOMIC);
-                netif_rx(skbc);
+                ecnl_to_host(skbc, host);
             }
-            else netif_rx(skb);
+            else ecnl_to_host(skb, host);
         }
 // FIXME: harden against ENCL_FW_TABLE_ENTRY_ARRAY ??
         if (parent > 0) {
@@ -987,10 +1017,12 @@ static int ecnl_receive_skb(int module_id, int index, struct sk_buff *skb) {
             set_next_id(skb, nextID);
 
             struct entl_driver *e_driver = &e_dev->drivers[id];
-            if (!e_driver) return -EINVAL;
             struct net_device *e1000e = e_driver->device;
             struct entl_driver_funcs *funcs = e_driver->funcs;
-            if (!e1000e || !funcs) return -EINVAL;
+            if (!e1000e || !funcs) {
+                kfree_skb(skb);
+                return -EINVAL;
+            }
 
             funcs->start_xmit(skb, e1000e);
         }
@@ -999,6 +1031,19 @@ static int ecnl_receive_skb(int module_id, int index, struct sk_buff *skb) {
     return 0;
 }
 
+static int ecnl_receive_skb(int module_id, int index, struct sk_buff *skb) {
+    return ecnl_forward_skb(module_id, index, skb, NULL);
+}
+
+// entl_rx_hook_t of the port, called from the e1000e NAPI poll with the data frames of the poll
+static void ecnl_rx_hook_receive(entl_rx_hook_t *hook, struct sk_buff_head *batch, struct sk_buff_head *host) {
+    struct entl_driver *e_driver = container_of(hook, struct entl_driver, rx_hook);
+    struct sk_buff *skb;
+    while ((skb = __skb_dequeue(batch)) != NULL) {
+        ecnl_forward_skb(e_driver->module_id, e_driver->index, skb, host);
+    }
+}
+
 
 // PUB/SUB section:
 
@@ -1307,7 +1352,12 @@ static struct net_device_ops ecnl_netdev_ops = {
 // --
 
 // ref: linux/netdevice.h - enum netdev_tx
-netdev_tx_t adapt_start_xmit(struct sk_buff *skb, struct net_device *e1000e) { return NETDEV_TX_BUSY; }
+// forwarded frames go through the qdisc of the port, this may run in its NAPI poll
+netdev_tx_t adapt_start_xmit(struct sk_buff *skb, struct net_device *e1000e) {
+    skb->dev = e1000e;
+    dev_queue_xmit(skb);
+    return NETDEV_TX_OK;
+}
 int adapt_send_AIT_message(struct sk_buff *skb, struct net_device *e1000e) { return -1; }
 int adapt_retrieve_AIT_message(struct net_device *e1000e, ec_ait_data_t *data) { return -1; }
 int adapt_write_alo_reg(struct net_device *e1000e, ec_alo_reg_t *reg) { return -1; }
@@ -1375,7 +1425,7 @@ int adapt_get_entl_state(struct net_device *e1000e, ec_state_t *state) {
 
     printk(KERN_INFO "adapt_get_entl_state e1000e \"%s\"\n", e1000e->name);
     printk(KERN_INFO "  entl_dev->name: \"%s\"\n", entl_dev->name);
-    printk(KERN_INFO "  entl_dev->queue_stopped: %d\n", entl_dev->queue_stopped);
+    printk(KERN_INFO "  queue stopped: %d, entl_tx_queue_stops: %llu\n", netif_queue_stopped(e1000e), (unsigned long long)READ_ONCE(entl_dev->stats.tx_queue_stops));
 
     char *nic_name = adapter->netdev->name;
     if (netif_carrier_ok(e1000e)) {
@@ -1509,6 +1559,8 @@ static int __init ecnl_init_module(void) {
 static void __exit ecnl_cleanup_module(void) {
     if (device_busy) {
         ECNL_DEBUG("ecnl_cleanup_module busy\n");
+        // the e1000e ports must not call into this module any more
+        ecnl_deregister_ports(0);
         //inter_module_unregister("ecnl_driver_funcs");
         device_busy = 0;
     }
@@ -43,8 +43,10 @@ struct entl_driver_funcs {
 struct entl_driver {
 	unsigned char *name ;
 	int index ;  // index in this device array
+	int module_id ;
 	struct net_device *device ;
 	struct entl_driver_funcs *funcs ;
+	entl_rx_hook_t rx_hook ;  // attached to the e1000e port, its frames come here from the NAPI poll
 } ;
 
 // for simiulation, we can create multiple instances of ENCL driver
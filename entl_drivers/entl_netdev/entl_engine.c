@@ -0,0 +1,10 @@
+/*
+ * ENTL protocol engine for entl_netdev
+ * Copyright(c) 2016 Earth Computing.
+ *
+ *   The state machine, the AIT rings and the link layer are the same code the e1000e driver links,
+ *   built again into this module so the two modules don't depend on each other.
+ */
+#include "entl_state_machine.c"
+#include "entl_ait_ring.c"
+#include "entl_link.c"
@@ -0,0 +1,42 @@
+/*
+ * ENTL over any net_device
+ * Copyright(c) 2016 Earth Computing.
+ *
+ */
+#ifndef _ENTL_NETDEV_H_
+#define _ENTL_NETDEV_H_
+
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+#include <linux/timer.h>
+#include <linux/workqueue.h>
+
+#include "entl_link.h"
+
+// upper device name is this prefix and the lower device name
+#define ENTL_PORT_PREFIX "entl_"
+
+// max lower devices named on the module parameter
+#define ENTL_PORT_MAX_LOWER 8
+
+// data frames waiting for the token, and when to wake the upper queue again
+#define ENTL_PORT_TX_QUEUE_LEN 256
+#define ENTL_PORT_TX_WAKE_THRESHOLD 32
+
+// first Hello retry after link up, same as the EntlHelloMs default of the e1000e driver
+#define ENTL_PORT_HELLO_MS 2
+
+/// One entangled link: the upper device the user sees, stacked on a lower device which carries the frames
+typedef struct entl_port {
+	entl_link_t link ;                     /// the state machine, its watchdog and the AIT rings, shared code with the e1000e driver
+
+	struct net_device *upper ;             /// entl_<lower>, data frames and the ENTL ioctls go here
+	struct net_device *lower ;             /// the carrier (veth, any ethernet device)
+	struct list_head list ;                /// on entl_ports, protected by rtnl
+
+	struct sk_buff_head tx_queue ;         /// data frames waiting for the token
+
+	u32 tokens_sent ;                      /// message only frames sent
+} entl_port_t ;
+
+#endif
@@ -0,0 +1,429 @@
+/*
+ * ENTL over any net_device
+ * Copyright(c) 2016 Earth Computing.
+ *
+ *   Runs the ENTL link protocol on a lower net_device picked by name (lower=veth0,veth1).
+ *   An upper device entl_<lower> is stacked on it: data frames sent to the upper device wait for the token,
+ *   received data frames come up on it, and it answers the same ENTL/ENTT ioctls as the e1000e driver,
+ *   so the entl_test tools work on it unchanged. Message only frames never leave the rx_handler.
+ *
+ *   Two network namespaces joined by a veth pair make a full entangled link on one machine:
+ *     ip netns add a ; ip netns add b
+ *     ip link add enta type veth peer name entb
+ *     ip link set enta netns a ; ip link set entb netns b
+ *     insmod entl_netdev.ko lower=enta,entb
+ *     ip -n a link set enta up ; ip -n a link set entl_enta up  (same for b)
+ *   Give the lower devices different names, the AIT ring device /dev/entt_<upper> is not per namespace.
+ */
+#include <linux/module.h>
+#include <linux/etherdevice.h>
+#include <linux/rtnetlink.h>
+#include <linux/pkt_sched.h>
+#include <linux/sched.h>
+#include <linux/version.h>
+
+#include "entl_netdev.h"
+
+#define DRV_NAME        "entl_netdev"
+#define DRV_VERSION     "0.0.1"
+
+static char *entl_lower[ENTL_PORT_MAX_LOWER] ;
+static int num_lower ;
+module_param_array_named( lower, entl_lower, charp, &num_lower, 0444 ) ;
+MODULE_PARM_DESC( lower, "lower devices to run ENTL on, e.g. lower=veth0,veth1" ) ;
+
+// all ports, protected by rtnl
+static LIST_HEAD( entl_ports ) ;
+
+// entl_link_ops_t inject, a message only frame down to the lower device, same frame as inject_message in entl_device.c
+//    it returns 0 if success, 1 if need to retry due to resource, -1 if fatal
+static int entl_port_inject( entl_link_t *link, __u16 u_addr, __u32 l_addr, int flag )
+{
+	entl_port_t *port = container_of( link, entl_port_t, link ) ;
+	struct net_device *lower = port->lower ;
+	struct entt_ioctl_ait_data* ait_data ;
+	struct sk_buff *skb ;
+	u32 ait_len ;
+	int len ;
+
+	if( !netif_running(lower) || !netif_carrier_ok(lower) ) return 1 ;
+
+	len = entl_link_message_len( link, flag, &ait_data, &ait_len ) ;
+	skb = alloc_skb( LL_RESERVED_SPACE(lower) + len, GFP_ATOMIC ) ;
+	if( !skb ) {
+		ENTL_DEBUG("ENTL %s entl_port_inject failed to allocate sk_buffer\n", port->upper->name );
+		return -1 ;
+	}
+	skb_reserve( skb, LL_RESERVED_SPACE(lower) ) ;
+	skb_reset_mac_header( skb ) ;
+	entl_link_message_fill( skb_put( skb, len ), len, lower->dev_addr, u_addr, l_addr, ait_data, ait_len ) ;
+	skb->dev = lower ;
+	skb->protocol = 0 ; // protocol type is not used anyway
+	skb->priority = TC_PRIO_CONTROL ;
+
+	if( dev_queue_xmit( skb ) != NET_XMIT_SUCCESS ) return 1 ;
+	port->tokens_sent++ ;
+	return 0 ;
+}
+
+// entl_link_ops_t tx_ready, dev_queue_xmit has its own queue so only the carrier counts
+static int entl_port_tx_ready( entl_link_t *link )
+{
+	entl_port_t *port = container_of( link, entl_port_t, link ) ;
+
+	if( !netif_running(port->lower) || !netif_carrier_ok(port->lower) ) return -ENETDOWN ;
+	return 0 ;
+}
+
+// hand a queued data frame to the lower device, it carries the token in the destination address
+static void entl_port_xmit_data( entl_port_t *port, struct sk_buff *skb )
+{
+	struct ethhdr *eth = (struct ethhdr *)skb->data ;
+
+	entl_link_tx_token( &port->link, eth ) ;
+	memcpy( eth->h_source, port->lower->dev_addr, ETH_ALEN ) ;
+
+	skb->dev = port->lower ;
+	dev_queue_xmit( skb ) ;
+}
+
+// entl_link_ops_t send_data, one waiting data frame answers the token
+static bool entl_port_send_data( entl_link_t *link )
+{
+	entl_port_t *port = container_of( link, entl_port_t, link ) ;
+	struct sk_buff *dt = skb_dequeue( &port->tx_queue ) ;
+
+	if( !dt ) return false ;
+	link->data_tokens++ ;
+	link->data_frames++ ;
+	entl_port_xmit_data( port, dt ) ;
+	if( netif_queue_stopped(port->upper) && skb_queue_len( &port->tx_queue ) + ENTL_PORT_TX_WAKE_THRESHOLD <= ENTL_PORT_TX_QUEUE_LEN ) {
+		netif_wake_queue( port->upper ) ;
+	}
+	return true ;
+}
+
+// entl_link_ops_t read_state, the lower device has no timing of its own
+static void entl_port_read_state( entl_link_t *link, struct entl_ioctl_data *data )
+{
+	entl_port_t *port = container_of( link, entl_port_t, link ) ;
+
+	data->link_state = netif_carrier_ok( port->lower ) ;
+}
+
+static const entl_link_ops_t entl_port_link_ops = {
+	.inject = entl_port_inject,
+	.tx_ready = entl_port_tx_ready,
+	.send_data = entl_port_send_data,
+	.read_state = entl_port_read_state,
+} ;
+
+// entl_link_copy_t of the skb, the payload may sit in frags
+static int entl_port_copy( const void *from, int offset, void *to, int len )
+{
+	return skb_copy_bits( (const struct sk_buff *)from, offset, to, len ) ;
+}
+
+// rx_handler on the lower device, the same processing as entl_device_process_rx_packet
+static rx_handler_result_t entl_port_rx( struct sk_buff **pskb )
+{
+	struct sk_buff *skb = *pskb ;
+	entl_port_t *port = rcu_dereference( skb->dev->rx_handler_data ) ;
+	struct ethhdr *eth ;
+	bool message_only ;
+
+	if( !netif_running(port->upper) ) return RX_HANDLER_PASS ;
+
+	// the tokens carry no protocol type and the data frames are ECLP/ECLD, same as entl_rx_frame_wanted.
+	//   Anything else is the lower device's own traffic
+	eth = eth_hdr( skb ) ;
+	if( eth->h_proto != 0 && eth->h_proto != ETH_P_ECLP && eth->h_proto != ETH_P_ECLD ) return RX_HANDLER_PASS ;
+
+	skb = skb_share_check( skb, GFP_ATOMIC ) ;
+	if( !skb ) return RX_HANDLER_CONSUMED ;
+	*pskb = skb ;
+	eth = eth_hdr( skb ) ;
+
+	message_only = (eth->h_dest[0] & (ENTL_MESSAGE_ONLY_U >> 8)) != 0 ;
+
+	// eth_type_trans has pulled the header, the AIT payload is the skb data
+	entl_link_rx( &port->link, (const u8 *)eth, entl_port_copy, skb, skb->len ) ;
+
+	// a token frame without the message only bit has nothing to deliver either, same as entl_clean_rx_irq
+	if( message_only || eth->h_proto == 0 ) {
+		consume_skb( skb ) ;
+		return RX_HANDLER_CONSUMED ;
+	}
+
+	// data frame, the destination is the token so deliver it as ours
+	skb->dev = port->upper ;
+	skb->pkt_type = PACKET_HOST ;
+	port->upper->stats.rx_packets++ ;
+	port->upper->stats.rx_bytes += skb->len ;
+	return RX_HANDLER_ANOTHER ;
+}
+
+static void entl_port_link_up( entl_port_t *port )
+{
+	ENTL_DEBUG("ENTL %s link up\n", port->upper->name );
+	netif_carrier_on( port->upper ) ;
+	entl_link_carrier_on( &port->link ) ;
+}
+
+static void entl_port_link_down( entl_port_t *port )
+{
+	ENTL_DEBUG("ENTL %s link down\n", port->upper->name );
+	netif_carrier_off( port->upper ) ;
+	entl_link_carrier_off( &port->link ) ;
+}
+
+// the state machine starts over with the address of the lower device, the frames carry it
+static void entl_port_reset( entl_port_t *port )
+{
+	entl_link_reset( &port->link ) ;
+	entl_link_set_addr( &port->link, port->lower->dev_addr ) ;
+}
+
+static int entl_port_open( struct net_device *netdev )
+{
+	entl_port_t *port = netdev_priv( netdev ) ;
+
+	entl_port_reset( port ) ;
+	entl_link_start( &port->link ) ;
+	netif_start_queue( netdev ) ;
+	if( netif_running(port->lower) && netif_carrier_ok(port->lower) ) entl_port_link_up( port ) ;
+	else entl_link_kick( &port->link ) ;
+	return 0 ;
+}
+
+static int entl_port_stop( struct net_device *netdev )
+{
+	entl_port_t *port = netdev_priv( netdev ) ;
+
+	netif_stop_queue( netdev ) ;
+	netif_carrier_off( netdev ) ;
+	entl_link_stop( &port->link ) ;
+	entl_state_error( &port->link.stm, ENTL_ERROR_FLAG_LINKDONW ) ;
+	skb_queue_purge( &port->tx_queue ) ;
+	return 0 ;
+}
+
+// data frames wait in tx_queue for the token, same rules as entl_tx_transmit
+static netdev_tx_t entl_port_start_xmit( struct sk_buff *skb, struct net_device *netdev )
+{
+	entl_port_t *port = netdev_priv( netdev ) ;
+	struct ethhdr *eth = (struct ethhdr *)skb->data ;
+
+	if( eth->h_proto != ETH_P_ECLP && eth->h_proto != ETH_P_ECLD ) {
+		netdev->stats.tx_dropped++ ;
+		dev_kfree_skb_any( skb ) ;
+		return NETDEV_TX_OK ;
+	}
+	// a GSO skb can't carry a token per frame
+	if( skb_is_gso(skb) ) {
+		struct sk_buff *segs = skb_gso_segment( skb, netdev->features & ~NETIF_F_GSO_MASK ) ;
+		dev_kfree_skb_any( skb ) ;
+		if( IS_ERR_OR_NULL(segs) ) {
+			netdev->stats.tx_dropped++ ;
+			return NETDEV_TX_OK ;
+		}
+		while( segs ) {
+			struct sk_buff *next = segs->next ;
+			segs->next = NULL ;
+			netdev->stats.tx_packets++ ;
+			netdev->stats.tx_bytes += segs->len ;
+			skb_queue_tail( &port->tx_queue, segs ) ;
+			segs = next ;
+		}
+	}
+	else {
+		netdev->stats.tx_packets++ ;
+		netdev->stats.tx_bytes += skb->len ;
+		skb_queue_tail( &port->tx_queue, skb ) ;
+	}
+
+	if( skb_queue_len( &port->tx_queue ) >= ENTL_PORT_TX_QUEUE_LEN ) {
+		netif_stop_queue( netdev ) ;
+		// the rx_handler may have drained the queue before it could see the stop
+		smp_mb() ;
+		if( skb_queue_len( &port->tx_queue ) + ENTL_PORT_TX_WAKE_THRESHOLD <= ENTL_PORT_TX_QUEUE_LEN ) netif_start_queue( netdev ) ;
+	}
+	return NETDEV_TX_OK ;
+}
+
+// the ENTL/ENTT ioctls are the ones of the e1000e driver, from entl_link_ioctl
+static int entl_port_ioctl( struct net_device *netdev, struct ifreq *ifr, int cmd )
+{
+	entl_port_t *port = netdev_priv( netdev ) ;
+
+	switch( cmd )
+	{
+	case SIOCDEVPRIVATE_ENTL_DO_INIT:
+		ENTL_DEBUG("ENTL %s ioctl initialize the port\n", netdev->name );
+		entl_port_reset( port ) ;
+		if( netif_carrier_ok(port->lower) ) entl_port_link_up( port ) ;
+		break ;
+	default:
+		return entl_link_ioctl( &port->link, ifr, cmd ) ;
+	}
+	return 0 ;
+}
+
+static const struct net_device_ops entl_port_netdev_ops = {
+	.ndo_open = entl_port_open,
+	.ndo_stop = entl_port_stop,
+	.ndo_start_xmit = entl_port_start_xmit,
+	.ndo_do_ioctl = entl_port_ioctl,
+	.ndo_set_mac_address = eth_mac_addr,
+	.ndo_validate_addr = eth_validate_addr,
+} ;
+
+static void entl_port_setup( struct net_device *netdev )
+{
+	ether_setup( netdev ) ;
+	netdev->netdev_ops = &entl_port_netdev_ops ;
+	netdev->priv_flags |= IFF_NO_QUEUE ;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,11,9)
+	netdev->needs_free_netdev = true ;
+#else
+	netdev->destructor = free_netdev ;
+#endif
+}
+
+static bool entl_port_wanted( struct net_device *netdev )
+{
+	int i ;
+
+	for( i = 0 ; i < num_lower ; i++ ) {
+		if( entl_lower[i] && !strcmp( entl_lower[i], netdev->name ) ) return true ;
+	}
+	return false ;
+}
+
+static entl_port_t *entl_port_find( struct net_device *netdev )
+{
+	entl_port_t *port ;
+
+	list_for_each_entry( port, &entl_ports, list ) {
+		if( port->lower == netdev ) return port ;
+	}
+	return NULL ;
+}
+
+// called with rtnl held
+static int entl_port_attach( struct net_device *lower_dev )
+{
+	struct net_device *upper ;
+	entl_port_t *port ;
+	char name[IFNAMSIZ] ;
+	int err ;
+
+	if( lower_dev->type != ARPHRD_ETHER || lower_dev->addr_len != ETH_ALEN ) return -EINVAL ;
+
+	snprintf( name, sizeof(name), ENTL_PORT_PREFIX "%s", lower_dev->name ) ;
+	upper = alloc_netdev( sizeof(entl_port_t), name, NET_NAME_USER, entl_port_setup ) ;
+	if( !upper ) return -ENOMEM ;
+
+	port = netdev_priv( upper ) ;
+	memset( port, 0, sizeof(entl_port_t) ) ;
+	port->upper = upper ;
+	port->lower = lower_dev ;
+	skb_queue_head_init( &port->tx_queue ) ;
+	entl_link_init( &port->link, &entl_port_link_ops, upper ) ;
+	port->link.hello_ms = ENTL_PORT_HELLO_MS ;
+
+	dev_net_set( upper, dev_net(lower_dev) ) ;
+	memcpy( upper->dev_addr, lower_dev->dev_addr, ETH_ALEN ) ;
+	upper->mtu = lower_dev->mtu ;
+
+	err = register_netdevice( upper ) ;
+	if( err ) {
+		free_netdev( upper ) ;
+		return err ;
+	}
+	netif_carrier_off( upper ) ;
+	entl_port_reset( port ) ;
+
+	// the ENTL messages use any destination address
+	err = dev_set_promiscuity( lower_dev, 1 ) ;
+	if( err ) goto err_unregister ;
+	err = netdev_rx_handler_register( lower_dev, entl_port_rx, port ) ;
+	if( err ) goto err_promisc ;
+
+	list_add( &port->list, &entl_ports ) ;
+	ENTL_DEBUG("ENTL %s attached on %s\n", upper->name, lower_dev->name );
+	return 0 ;
+
+err_promisc:
+	dev_set_promiscuity( lower_dev, -1 ) ;
+err_unregister:
+	unregister_netdevice( upper ) ;
+	return err ;
+}
+
+// called with rtnl held
+static void entl_port_detach( entl_port_t *port )
+{
+	ENTL_DEBUG("ENTL %s detached from %s\n", port->upper->name, port->lower->name );
+	list_del( &port->list ) ;
+	netdev_rx_handler_unregister( port->lower ) ;
+	dev_set_promiscuity( port->lower, -1 ) ;
+	entl_link_stop( &port->link ) ;
+	skb_queue_purge( &port->tx_queue ) ;
+	entt_ait_ring_destroy( &port->link.ait_ring ) ;
+	unregister_netdevice( port->upper ) ;
+}
+
+static int entl_port_netdev_event( struct notifier_block *nb, unsigned long event, void *ptr )
+{
+	struct net_device *netdev = netdev_notifier_info_to_dev( ptr ) ;
+	entl_port_t *port = entl_port_find( netdev ) ;
+
+	switch( event ) {
+	case NETDEV_REGISTER:
+		if( !port && entl_port_wanted( netdev ) ) entl_port_attach( netdev ) ;
+		break ;
+	case NETDEV_UNREGISTER:
+		// also on the move to another namespace, NETDEV_REGISTER attaches again there
+		if( port ) entl_port_detach( port ) ;
+		break ;
+	case NETDEV_UP:
+	case NETDEV_CHANGE:
+		if( port && netif_running(port->upper) && netif_carrier_ok(netdev) && !netif_carrier_ok(port->upper) ) entl_port_link_up( port ) ;
+		else if( port && netif_running(port->upper) && !netif_carrier_ok(netdev) && netif_carrier_ok(port->upper) ) entl_port_link_down( port ) ;
+		break ;
+	case NETDEV_GOING_DOWN:
+		if( port && netif_running(port->upper) ) entl_port_link_down( port ) ;
+		break ;
+	}
+	return NOTIFY_DONE ;
+}
+
+static struct notifier_block entl_port_notifier = {
+	.notifier_call = entl_port_netdev_event,
+} ;
+
+static int __init entl_netdev_init( void )
+{
+	ENTL_DEBUG("ENTL %s version %s\n", DRV_NAME, DRV_VERSION );
+	// replays NETDEV_REGISTER for the devices which already exist, in all namespaces
+	return register_netdevice_notifier( &entl_port_notifier ) ;
+}
+
+static void __exit entl_netdev_exit( void )
+{
+	entl_port_t *port, *tmp ;
+
+	unregister_netdevice_notifier( &entl_port_notifier ) ;
+	rtnl_lock() ;
+	list_for_each_entry_safe( port, tmp, &entl_ports, list ) entl_port_detach( port ) ;
+	rtnl_unlock() ;
+}
+
+module_init( entl_netdev_init ) ;
+module_exit( entl_netdev_exit ) ;
+
+MODULE_AUTHOR( "Earth Computing" ) ;
+MODULE_DESCRIPTION( "ENTL link protocol over any net_device" ) ;
+MODULE_LICENSE( "GPL" ) ;
+MODULE_VERSION( DRV_VERSION ) ;
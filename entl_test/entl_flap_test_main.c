@@ -0,0 +1,110 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright © 2016-present Earth Computing Corporation. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE.txt in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+
+// Flap and recover benchmark, time from link up to the first SEND state.
+//   Takes the port down and up through the driver link hooks, then waits for the driver to count the
+//   next entangle. The peer port sees the Hello in the middle of the exchange and sets its error state,
+//   so when both ports are on this host give the peer too and its error is read the way the daemon does.
+//   Compare the result with different EntlHelloMs values.
+
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "entl_user_api.h"
+
+#define FLAP_TIMEOUT_MS 5000
+
+static int sock;
+
+static int do_ioctl( char *name, int cmd, struct entl_ioctl_data *data ) {
+	struct ifreq ifr ;
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, name, sizeof(ifr.ifr_name));
+	memset(data, 0, sizeof(struct entl_ioctl_data));
+	ifr.ifr_data = (char *)data ;
+	if (ioctl(sock, cmd, &ifr) == -1) {
+		printf( "ioctl %x failed on %s\n", cmd, name );
+		return 0 ;
+	}
+	return 1 ;
+}
+
+static long now_ms( void ) {
+	struct timespec ts ;
+	clock_gettime( CLOCK_MONOTONIC, &ts ) ;
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000 ;
+}
+
+static int cmp_u32( const void *a, const void *b ) {
+	u32 x = *(const u32 *)a, y = *(const u32 *)b ;
+	return x < y ? -1 : x > y ;
+}
+
+int main( int argc, char *argv[] ) {
+	struct entl_ioctl_data data ;
+	char *port, *peer ;
+	u32 *ns ;
+	int count, done = 0, timeouts = 0, i ;
+	double sum = 0 ;
+
+	if( argc < 2 ) {
+		printf( "%s needs <device name> (e.g. enp6s0) [peer device name or -] [count] as the argument\n", argv[0] ) ;
+		return 0 ;
+	}
+	port = argv[1] ;
+	peer = argc > 2 && strcmp(argv[2], "-") ? argv[2] : NULL ;
+	count = argc > 3 ? atoi(argv[3]) : 100 ;
+	if( count <= 0 ) count = 1 ;
+	ns = calloc( count, sizeof(u32) ) ;
+
+	// Creating socet
+	if ((sock = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+		perror("cannot create socket");
+		return 0;
+	}
+
+	for( i = 0 ; i < count ; i++ ) {
+		u32 entangles ;
+		long start ;
+		if( !do_ioctl( port, SIOCDEVPRIVATE_ENTL_RD_CURRENT, &data ) ) return 0 ;
+		if( !data.link_state ) {
+			printf( "%s link is down\n", port ) ;
+			return 0 ;
+		}
+		entangles = data.entangles ;
+		if( !do_ioctl( port, SIOCDEVPRIVATE_ENTL_FLAP, &data ) ) return 0 ;
+		start = now_ms() ;
+		for( ;; ) {
+			if( peer && !do_ioctl( peer, SIOCDEVPRIVATE_ENTL_RD_ERROR, &data ) ) return 0 ;
+			if( !do_ioctl( port, SIOCDEVPRIVATE_ENTL_RD_CURRENT, &data ) ) return 0 ;
+			if( data.entangles != entangles ) {
+				ns[done++] = data.entangle_ns ;
+				sum += data.entangle_ns ;
+				break ;
+			}
+			if( now_ms() - start > FLAP_TIMEOUT_MS ) {
+				timeouts++ ;
+				break ;
+			}
+			usleep( 100 ) ;
+		}
+		// let the exchange settle before the next flap
+		usleep( 10000 ) ;
+	}
+
+	printf( "%s %d flaps, %d entangled, %d timed out after %d ms\n", port, count, done, timeouts, FLAP_TIMEOUT_MS ) ;
+	if( done == 0 ) return 0 ;
+	qsort( ns, done, sizeof(u32), cmp_u32 ) ;
+	printf( "  link up to SEND: min %u avg %.0f p50 %u p99 %u max %u ns\n", ns[0], sum / done, ns[done / 2], ns[(done * 99) / 100], ns[done - 1] ) ;
+	return 0 ;
+}
@@ -0,0 +1,121 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright © 2016-present Earth Computing Corporation. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE.txt in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+
+// Aggregate token rate of the ENTL ports of a cell with all of them packed on cpu 0, then with the
+//   placement layout of the driver. Writes /sys/class/net/<port>/entl/token_cpu and data_cpus, so run as root.
+//   The ports are left with the layout of the driver.
+
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "entl_user_api.h"
+
+#define MAX_PORTS 16
+
+static int sock;
+
+static int read_current( char *name, struct entl_ioctl_data *data ) {
+	struct ifreq ifr ;
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, name, sizeof(ifr.ifr_name));
+	memset(data, 0, sizeof(struct entl_ioctl_data));
+	ifr.ifr_data = (char *)data ;
+	if (ioctl(sock, SIOCDEVPRIVATE_ENTL_RD_CURRENT, &ifr) == -1) {
+		printf( "SIOCDEVPRIVATE_ENTL_RD_CURRENT failed on %s\n", name );
+		return 0 ;
+	}
+	return 1 ;
+}
+
+// every received token lands in one bucket of the round trip histogram
+static unsigned long tokens( struct entl_ioctl_data *data ) {
+	unsigned long sum = 0 ;
+	int i ;
+	for( i = 0 ; i < ENTL_RTT_HIST_BUCKETS ; i++ ) sum += data->rtt_hist[i] ;
+	return sum ;
+}
+
+static int write_sysfs( char *name, char *file, char *value ) {
+	char path[128] ;
+	FILE *fp ;
+	snprintf( path, sizeof(path), "/sys/class/net/%s/entl/%s", name, file ) ;
+	if( !(fp = fopen( path, "w" )) ) {
+		perror( path ) ;
+		return 0 ;
+	}
+	fprintf( fp, "%s\n", value ) ;
+	return fclose( fp ) == 0 ;
+}
+
+static void print_layout( char *name ) {
+	char path[128], line[256] ;
+	FILE *fp ;
+	snprintf( path, sizeof(path), "/sys/class/net/%s/entl/layout", name ) ;
+	if( !(fp = fopen( path, "r" )) ) return ;
+	while( fgets( line, sizeof(line), fp ) ) printf( "    %s", line ) ;
+	fclose( fp ) ;
+}
+
+// set the placement of all ports and measure the token rate, returns the aggregate tokens/s
+static double measure( char *label, char **ports, int num_ports, char *token_cpu, char *data_cpus, int seconds ) {
+	struct entl_ioctl_data before[MAX_PORTS], after ;
+	double total = 0 ;
+	int i ;
+
+	for( i = 0 ; i < num_ports ; i++ ) {
+		if( !write_sysfs( ports[i], "token_cpu", token_cpu ) || !write_sysfs( ports[i], "data_cpus", data_cpus ) ) exit( 1 ) ;
+	}
+	printf( "%s:\n", label ) ;
+	print_layout( ports[0] ) ;
+	sleep( 1 ) ;  // let the moved threads and interrupts settle
+
+	for( i = 0 ; i < num_ports ; i++ ) {
+		if( !read_current( ports[i], &before[i] ) ) exit( 1 ) ;
+	}
+	sleep( seconds ) ;
+	for( i = 0 ; i < num_ports ; i++ ) {
+		double rate ;
+		if( !read_current( ports[i], &after ) ) exit( 1 ) ;
+		rate = (double)(tokens( &after ) - tokens( &before[i] )) / seconds ;
+		printf( "  %-12s %12.0f tokens/s\n", ports[i], rate ) ;
+		total += rate ;
+	}
+	printf( "  %-12s %12.0f tokens/s\n", "total", total ) ;
+	return total ;
+}
+
+int main( int argc, char *argv[] ) {
+	double packed, spread ;
+	int seconds, num_ports ;
+	char **ports ;
+
+	if( argc < 3 ) {
+		printf( "%s needs <seconds> <device name> [<device name> ...] (e.g. 10 enp6s0 enp7s0) as the argument\n", argv[0] ) ;
+		return 0 ;
+	}
+	seconds = atoi(argv[1]) ;
+	if( seconds <= 0 ) seconds = 10 ;
+	ports = &argv[2] ;
+	num_ports = argc - 2 ;
+	if( num_ports > MAX_PORTS ) num_ports = MAX_PORTS ;
+
+	// Creating socet
+	if ((sock = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+		perror("cannot create socket");
+		return 0;
+	}
+
+	packed = measure( "all ports on cpu 0", ports, num_ports, "0", "1", seconds ) ;
+	spread = measure( "driver placement", ports, num_ports, "-1", "0", seconds ) ;
+	if( packed > 0 ) printf( "placement / packed: %.2f\n", spread / packed ) ;
+	return 0 ;
+}
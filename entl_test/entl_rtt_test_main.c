@@ -0,0 +1,76 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright © 2016-present Earth Computing Corporation. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE.txt in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+
+// Prints the token round trip histogram of a port over a measurement period.
+//   Load the driver with and without EntlBusyPoll=<cpu> and compare the two outputs.
+
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "entl_user_api.h"
+
+static int sock;
+static struct ifreq ifr;
+
+static int read_current( struct entl_ioctl_data *data ) {
+	memset(data, 0, sizeof(struct entl_ioctl_data));
+	ifr.ifr_data = (char *)data ;
+	if (ioctl(sock, SIOCDEVPRIVATE_ENTL_RD_CURRENT, &ifr) == -1) {
+		printf( "SIOCDEVPRIVATE_ENTL_RD_CURRENT failed on %s\n",ifr.ifr_name );
+		return 0 ;
+	}
+	return 1 ;
+}
+
+int main( int argc, char *argv[] ) {
+	struct entl_ioctl_data before, after ;
+	u32 hist[ENTL_RTT_HIST_BUCKETS] ;
+	u32 total = 0, sum = 0 ;
+	int seconds, i ;
+
+	if( argc < 2 ) {
+		printf( "%s needs <device name> (e.g. enp6s0) [seconds] as the argument\n", argv[0] ) ;
+		return 0 ;
+	}
+	seconds = argc > 2 ? atoi(argv[2]) : 10 ;
+
+	// Creating socet
+	if ((sock = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+		perror("cannot create socket");
+		return 0;
+	}
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, argv[1], sizeof(ifr.ifr_name));
+
+	if( !read_current( &before ) ) return 0 ;
+	sleep( seconds ) ;
+	if( !read_current( &after ) ) return 0 ;
+
+	for( i = 0 ; i < ENTL_RTT_HIST_BUCKETS ; i++ ) {
+		hist[i] = after.rtt_hist[i] - before.rtt_hist[i] ;
+		total += hist[i] ;
+	}
+	printf( "%s token round trip over %d sec: %u tokens, %u busy poll periods\n", argv[1], seconds, total, after.busy_polls - before.busy_polls ) ;
+	if( total == 0 ) return 0 ;
+
+	for( i = 0 ; i < ENTL_RTT_HIST_BUCKETS ; i++ ) {
+		unsigned long lo = 1UL << (i + ENTL_RTT_HIST_SHIFT) ;
+		int p ;
+		sum += hist[i] ;
+		if( i == 0 ) printf( "  %9s - %9lu ns : %10u %6.2f%% %6.2f%% ", "", lo * 2, hist[i], hist[i] * 100.0 / total, sum * 100.0 / total ) ;
+		else if( i == ENTL_RTT_HIST_BUCKETS - 1 ) printf( "  %9lu - %9s ns : %10u %6.2f%% %6.2f%% ", lo, "", hist[i], hist[i] * 100.0 / total, sum * 100.0 / total ) ;
+		else printf( "  %9lu - %9lu ns : %10u %6.2f%% %6.2f%% ", lo, lo * 2, hist[i], hist[i] * 100.0 / total, sum * 100.0 / total ) ;
+		for( p = 0 ; p < (int)(hist[i] * 40.0 / total) ; p++ ) printf( "#" ) ;
+		printf( "\n" ) ;
+	}
+	return 0 ;
+}
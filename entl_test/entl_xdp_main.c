@@ -0,0 +1,663 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright © 2016-present Earth Computing Corporation. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE.txt in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+
+// ENTL endpoint in user space over AF_XDP, and a benchmark against the in-kernel one.
+//
+//   entl_xdp <device name> [seconds] [AIT bytes] [queue]
+//     Attaches a small XDP program which redirects every frame of <queue> (default 0) to an AF_XDP socket,
+//     and runs the ENTL token exchange from user space with the driver's own entl_state_machine.c.
+//     Zero copy is tried first, then copy mode (veth and drivers without zero copy support).
+//   entl_xdp -k <device name> [seconds] [AIT bytes]
+//     Same measurement on a port run by the kernel (e1000e or entl_netdev) through the ENTL ioctls.
+//
+//   Both modes keep the AIT send queue full and print every second the event rate (event_i_know of
+//   the state machine, which counts the tokens received) and the AIT messages/bytes received.
+//   Run the same mode on the peer. Steer the ENTL traffic to <queue> (ethtool -L <dev> combined 1) on
+//   multi-queue devices, frames of the other queues go up the normal stack.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <net/if.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <linux/bpf.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include "entl_state_machine.h"
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+#define XDP_NUM_FRAMES 4096
+#define XDP_FRAME_SIZE 2048
+#define XDP_RING_SIZE 1024           // each of fill, completion, rx and tx, power of 2
+#define XDP_RX_BATCH 64
+
+// resend the last message when nothing came back for this long, the driver waits one second
+#define HELLO_INTERVAL_NS 100000000
+
+int entl_kshim_verbose = 0 ;
+
+static volatile int running = 1 ;
+
+static void stop_handler( int signum __attribute__((unused)) ) {
+	running = 0 ;
+}
+
+static unsigned long long now_ns( void ) {
+	struct timespec ts ;
+	clock_gettime( CLOCK_MONOTONIC, &ts ) ;
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec ;
+}
+
+// one producer or consumer ring of the socket
+typedef struct xdp_ring {
+	__u32 *producer ;
+	__u32 *consumer ;
+	__u32 *flags ;
+	void *ring ;
+	__u32 cached ;           // our own index, producer for fill/tx, consumer for rx/completion
+	size_t map_len ;
+	void *map ;
+} xdp_ring_t ;
+
+typedef struct xdp_port {
+	int ifindex ;
+	char name[IFNAMSIZ] ;
+	unsigned char mac[ETH_ALEN] ;
+	int xsk ;
+	int prog_fd ;
+	int map_fd ;
+	__u32 xdp_flags ;
+	int need_wakeup ;
+	unsigned char *umem ;
+	xdp_ring_t fill, comp, rx, tx ;
+	__u64 free_frames[XDP_NUM_FRAMES / 2] ;   // tx frames not in flight
+	int num_free ;
+	entl_state_machine_t stm ;
+	unsigned long long last_rx_ns ;
+	unsigned long long tx_frames, rx_frames, tx_busy ;
+	unsigned long long ait_sent, ait_received, ait_bytes ;
+} xdp_port_t ;
+
+static int sys_bpf( int cmd, union bpf_attr *attr ) {
+	return syscall( __NR_bpf, cmd, attr, sizeof(*attr) ) ;
+}
+
+// XSKMAP with one entry per rx queue
+static int create_xsk_map( void ) {
+	union bpf_attr attr ;
+	memset( &attr, 0, sizeof(attr) ) ;
+	attr.map_type = BPF_MAP_TYPE_XSKMAP ;
+	attr.key_size = sizeof(__u32) ;
+	attr.value_size = sizeof(__u32) ;
+	attr.max_entries = 64 ;
+	return sys_bpf( BPF_MAP_CREATE, &attr ) ;
+}
+
+// return bpf_redirect_map( &xsks, ctx->rx_queue_index, XDP_PASS ) ;
+//   queues without a socket in the map pass the frame to the stack
+static int load_redirect_prog( int map_fd ) {
+	struct bpf_insn prog[] = {
+		{ .code = BPF_LDX | BPF_W | BPF_MEM, .dst_reg = BPF_REG_2, .src_reg = BPF_REG_1, .off = offsetof(struct xdp_md, rx_queue_index) },
+		{ .code = BPF_LD | BPF_DW | BPF_IMM, .dst_reg = BPF_REG_1, .src_reg = BPF_PSEUDO_MAP_FD, .imm = map_fd },
+		{ 0 },
+		{ .code = BPF_ALU64 | BPF_MOV | BPF_K, .dst_reg = BPF_REG_3, .imm = XDP_PASS },
+		{ .code = BPF_JMP | BPF_CALL, .imm = BPF_FUNC_redirect_map },
+		{ .code = BPF_JMP | BPF_EXIT },
+	} ;
+	static char log[4096] ;
+	union bpf_attr attr ;
+	int fd ;
+
+	memset( &attr, 0, sizeof(attr) ) ;
+	attr.prog_type = BPF_PROG_TYPE_XDP ;
+	attr.insns = (__u64)(unsigned long)prog ;
+	attr.insn_cnt = sizeof(prog) / sizeof(prog[0]) ;
+	attr.license = (__u64)(unsigned long)"GPL" ;
+	attr.log_buf = (__u64)(unsigned long)log ;
+	attr.log_size = sizeof(log) ;
+	attr.log_level = 1 ;
+	fd = sys_bpf( BPF_PROG_LOAD, &attr ) ;
+	if( fd < 0 ) printf( "BPF_PROG_LOAD failed: %s\n%s\n", strerror(errno), log ) ;
+	return fd ;
+}
+
+// RTM_SETLINK with IFLA_XDP, fd -1 detaches
+static int set_link_xdp( int ifindex, int fd, __u32 flags ) {
+	struct {
+		struct nlmsghdr nh ;
+		struct ifinfomsg ifi ;
+		char attrs[64] ;
+	} req ;
+	struct {
+		struct nlmsghdr nh ;
+		struct nlmsgerr err ;
+	} ack ;
+	struct rtattr *xdp, *rta ;
+	int sock, ret ;
+
+	sock = socket( AF_NETLINK, SOCK_RAW, NETLINK_ROUTE ) ;
+	if( sock < 0 ) return -errno ;
+
+	memset( &req, 0, sizeof(req) ) ;
+	req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg)) ;
+	req.nh.nlmsg_type = RTM_SETLINK ;
+	req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK ;
+	req.ifi.ifi_family = AF_UNSPEC ;
+	req.ifi.ifi_index = ifindex ;
+
+	xdp = (struct rtattr *)((char *)&req + NLMSG_ALIGN(req.nh.nlmsg_len)) ;
+	xdp->rta_type = IFLA_XDP | NLA_F_NESTED ;
+	xdp->rta_len = RTA_LENGTH(0) ;
+
+	rta = (struct rtattr *)((char *)xdp + RTA_ALIGN(xdp->rta_len)) ;
+	rta->rta_type = IFLA_XDP_FD ;
+	rta->rta_len = RTA_LENGTH(sizeof(int)) ;
+	memcpy( RTA_DATA(rta), &fd, sizeof(int) ) ;
+	xdp->rta_len += RTA_ALIGN(rta->rta_len) ;
+
+	rta = (struct rtattr *)((char *)xdp + RTA_ALIGN(xdp->rta_len)) ;
+	rta->rta_type = IFLA_XDP_FLAGS ;
+	rta->rta_len = RTA_LENGTH(sizeof(__u32)) ;
+	memcpy( RTA_DATA(rta), &flags, sizeof(__u32) ) ;
+	xdp->rta_len += RTA_ALIGN(rta->rta_len) ;
+
+	req.nh.nlmsg_len = NLMSG_ALIGN(req.nh.nlmsg_len) + RTA_ALIGN(xdp->rta_len) ;
+
+	ret = 0 ;
+	if( send( sock, &req, req.nh.nlmsg_len, 0 ) < 0 ) ret = -errno ;
+	else if( recv( sock, &ack, sizeof(ack), 0 ) < 0 ) ret = -errno ;
+	else if( ack.nh.nlmsg_type == NLMSG_ERROR ) ret = ack.err.error ;
+	close( sock ) ;
+	return ret ;
+}
+
+static int map_ring( xdp_port_t *port, xdp_ring_t *r, struct xdp_ring_offset *off, size_t desc_size, off_t pgoff ) {
+	r->map_len = off->desc + XDP_RING_SIZE * desc_size ;
+	r->map = mmap( NULL, r->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, port->xsk, pgoff ) ;
+	if( r->map == MAP_FAILED ) {
+		perror( "ring mmap failed" ) ;
+		return 0 ;
+	}
+	r->producer = (__u32 *)((char *)r->map + off->producer) ;
+	r->consumer = (__u32 *)((char *)r->map + off->consumer) ;
+	r->flags = (__u32 *)((char *)r->map + off->flags) ;
+	r->ring = (char *)r->map + off->desc ;
+	return 1 ;
+}
+
+static int xsk_setup( xdp_port_t *port, int queue ) {
+	struct xdp_umem_reg umem ;
+	struct xdp_mmap_offsets off ;
+	struct sockaddr_xdp sxdp ;
+	socklen_t optlen ;
+	int size = XDP_RING_SIZE ;
+	__u64 *fill ;
+	int i ;
+
+	port->xsk = socket( AF_XDP, SOCK_RAW, 0 ) ;
+	if( port->xsk < 0 ) {
+		perror( "cannot create AF_XDP socket" ) ;
+		return 0 ;
+	}
+
+	port->umem = mmap( NULL, XDP_NUM_FRAMES * XDP_FRAME_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 ) ;
+	if( port->umem == MAP_FAILED ) {
+		perror( "cannot allocate umem" ) ;
+		return 0 ;
+	}
+	memset( &umem, 0, sizeof(umem) ) ;
+	umem.addr = (__u64)(unsigned long)port->umem ;
+	umem.len = XDP_NUM_FRAMES * XDP_FRAME_SIZE ;
+	umem.chunk_size = XDP_FRAME_SIZE ;
+	if( setsockopt( port->xsk, SOL_XDP, XDP_UMEM_REG, &umem, sizeof(umem) ) ||
+	    setsockopt( port->xsk, SOL_XDP, XDP_UMEM_FILL_RING, &size, sizeof(size) ) ||
+	    setsockopt( port->xsk, SOL_XDP, XDP_UMEM_COMPLETION_RING, &size, sizeof(size) ) ||
+	    setsockopt( port->xsk, SOL_XDP, XDP_RX_RING, &size, sizeof(size) ) ||
+	    setsockopt( port->xsk, SOL_XDP, XDP_TX_RING, &size, sizeof(size) ) ) {
+		perror( "AF_XDP ring setup failed" ) ;
+		return 0 ;
+	}
+
+	optlen = sizeof(off) ;
+	if( getsockopt( port->xsk, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen ) ) {
+		perror( "XDP_MMAP_OFFSETS failed" ) ;
+		return 0 ;
+	}
+	if( !map_ring( port, &port->fill, &off.fr, sizeof(__u64), XDP_UMEM_PGOFF_FILL_RING ) ||
+	    !map_ring( port, &port->comp, &off.cr, sizeof(__u64), XDP_UMEM_PGOFF_COMPLETION_RING ) ||
+	    !map_ring( port, &port->rx, &off.rx, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING ) ||
+	    !map_ring( port, &port->tx, &off.tx, sizeof(struct xdp_desc), XDP_PGOFF_TX_RING ) ) return 0 ;
+
+	// the first half of the umem is for rx and lives on the fill ring, the second half is for tx
+	fill = (__u64 *)port->fill.ring ;
+	for( i = 0 ; i < XDP_NUM_FRAMES / 2 && i < XDP_RING_SIZE ; i++ ) fill[i] = (__u64)i * XDP_FRAME_SIZE ;
+	port->fill.cached = i ;
+	__atomic_store_n( port->fill.producer, i, __ATOMIC_RELEASE ) ;
+	for( i = 0 ; i < XDP_NUM_FRAMES / 2 ; i++ ) port->free_frames[i] = (__u64)(XDP_NUM_FRAMES / 2 + i) * XDP_FRAME_SIZE ;
+	port->num_free = XDP_NUM_FRAMES / 2 ;
+
+	memset( &sxdp, 0, sizeof(sxdp) ) ;
+	sxdp.sxdp_family = AF_XDP ;
+	sxdp.sxdp_ifindex = port->ifindex ;
+	sxdp.sxdp_queue_id = queue ;
+	sxdp.sxdp_flags = XDP_ZEROCOPY | XDP_USE_NEED_WAKEUP ;
+	if( bind( port->xsk, (struct sockaddr *)&sxdp, sizeof(sxdp) ) == 0 ) {
+		printf( "%s queue %d bound in zero copy mode\n", port->name, queue ) ;
+	}
+	else {
+		sxdp.sxdp_flags = XDP_COPY | XDP_USE_NEED_WAKEUP ;
+		if( bind( port->xsk, (struct sockaddr *)&sxdp, sizeof(sxdp) ) ) {
+			perror( "AF_XDP bind failed" ) ;
+			return 0 ;
+		}
+		printf( "%s queue %d bound in copy mode\n", port->name, queue ) ;
+	}
+	port->need_wakeup = 1 ;
+	return 1 ;
+}
+
+static int xdp_attach( xdp_port_t *port, int queue ) {
+	__u32 key = queue ;
+	union bpf_attr attr ;
+	int ret ;
+
+	port->map_fd = create_xsk_map() ;
+	if( port->map_fd < 0 ) {
+		printf( "cannot create XSKMAP: %s\n", strerror(errno) ) ;
+		return 0 ;
+	}
+	port->prog_fd = load_redirect_prog( port->map_fd ) ;
+	if( port->prog_fd < 0 ) return 0 ;
+
+	port->xdp_flags = XDP_FLAGS_UPDATE_IF_NOEXIST | XDP_FLAGS_DRV_MODE ;
+	ret = set_link_xdp( port->ifindex, port->prog_fd, port->xdp_flags ) ;
+	if( ret ) {
+		// no native XDP in the driver, the generic hook still works
+		port->xdp_flags = XDP_FLAGS_UPDATE_IF_NOEXIST | XDP_FLAGS_SKB_MODE ;
+		ret = set_link_xdp( port->ifindex, port->prog_fd, port->xdp_flags ) ;
+	}
+	if( ret ) {
+		printf( "cannot attach XDP program to %s: %s\n", port->name, strerror(-ret) ) ;
+		return 0 ;
+	}
+	printf( "%s XDP program attached in %s mode\n", port->name, (port->xdp_flags & XDP_FLAGS_DRV_MODE) ? "driver" : "generic" ) ;
+
+	if( !xsk_setup( port, queue ) ) return 0 ;
+
+	memset( &attr, 0, sizeof(attr) ) ;
+	attr.map_fd = port->map_fd ;
+	attr.key = (__u64)(unsigned long)&key ;
+	attr.value = (__u64)(unsigned long)&port->xsk ;
+	if( sys_bpf( BPF_MAP_UPDATE_ELEM, &attr ) ) {
+		printf( "cannot put the socket in XSKMAP: %s\n", strerror(errno) ) ;
+		return 0 ;
+	}
+	return 1 ;
+}
+
+static void xdp_detach( xdp_port_t *port ) {
+	set_link_xdp( port->ifindex, -1, port->xdp_flags & ~XDP_FLAGS_UPDATE_IF_NOEXIST ) ;
+}
+
+// completed tx frames go back to the free list
+static void recycle_tx( xdp_port_t *port ) {
+	__u32 prod = __atomic_load_n( port->comp.producer, __ATOMIC_ACQUIRE ) ;
+	__u64 *comp = (__u64 *)port->comp.ring ;
+
+	while( port->comp.cached != prod ) {
+		port->free_frames[port->num_free++] = comp[port->comp.cached & (XDP_RING_SIZE - 1)] ;
+		port->comp.cached++ ;
+	}
+	__atomic_store_n( port->comp.consumer, port->comp.cached, __ATOMIC_RELEASE ) ;
+}
+
+static void set_dest( unsigned char *d_addr, __u16 u_addr, __u32 l_addr ) {
+	d_addr[0] = u_addr >> 8 ;
+	d_addr[1] = u_addr ;
+	d_addr[2] = l_addr >> 24 ;
+	d_addr[3] = l_addr >> 16 ;
+	d_addr[4] = l_addr >> 8 ;
+	d_addr[5] = l_addr ;
+}
+
+// same frame as the driver's inject_message: message only token, AIT payload is the u32 length then the data
+//   returns 0 on success, 1 when there is no tx room (try again)
+static int inject_message( xdp_port_t *port, __u16 u_addr, __u32 l_addr, int flag ) {
+	struct xdp_desc *desc ;
+	struct ethhdr *eth ;
+	u32 ait_len = 0 ;
+	__u64 addr ;
+	int len ;
+
+	if( port->num_free == 0 ) recycle_tx( port ) ;
+	if( port->num_free == 0 || port->tx.cached - __atomic_load_n( port->tx.consumer, __ATOMIC_ACQUIRE ) >= XDP_RING_SIZE ) {
+		port->tx_busy++ ;
+		return 1 ;
+	}
+	addr = port->free_frames[--port->num_free] ;
+	eth = (struct ethhdr *)(port->umem + addr) ;
+
+	len = ETH_HLEN ;
+	if( flag & ENTL_ACTION_SEND_AIT ) {
+		struct entt_ioctl_ait_data *ait_data = entl_next_AIT_message( &port->stm ) ;
+		if( ait_data ) {
+			unsigned char *cp = (unsigned char *)(eth + 1) ;
+			ait_len = ait_data->message_len < MAX_AIT_MESSAGE_SIZE ? ait_data->message_len : MAX_AIT_MESSAGE_SIZE ;
+			memcpy( cp, &ait_len, sizeof(u32) ) ;
+			memcpy( cp + sizeof(u32), ait_data->data, ait_len ) ;
+			len += sizeof(u32) + ait_len ;
+			port->ait_sent++ ;
+		}
+	}
+	if( len < ETH_ZLEN ) {
+		memset( (unsigned char *)eth + len, 0, ETH_ZLEN - len ) ;
+		len = ETH_ZLEN ;
+	}
+	set_dest( eth->h_dest, u_addr | ENTL_MESSAGE_ONLY_U, l_addr ) ;
+	memcpy( eth->h_source, port->mac, ETH_ALEN ) ;
+	eth->h_proto = 0 ; // protocol type is not used anyway
+
+	desc = &((struct xdp_desc *)port->tx.ring)[port->tx.cached & (XDP_RING_SIZE - 1)] ;
+	desc->addr = addr ;
+	desc->len = len ;
+	desc->options = 0 ;
+	port->tx.cached++ ;
+	__atomic_store_n( port->tx.producer, port->tx.cached, __ATOMIC_RELEASE ) ;
+	if( !port->need_wakeup || (*port->tx.flags & XDP_RING_NEED_WAKEUP) ) sendto( port->xsk, NULL, 0, MSG_DONTWAIT, NULL, 0 ) ;
+	port->tx_frames++ ;
+	return 0 ;
+}
+
+static void send_token( xdp_port_t *port ) {
+	__u16 d_u_addr ;
+	__u32 d_l_addr ;
+	int ret ;
+
+	ret = entl_next_send( &port->stm, &d_u_addr, &d_l_addr ) ;
+	if( (d_u_addr & (u16)ENTL_MESSAGE_MASK) == ENTL_MESSAGE_NOP_U ) return ;  // last minute check
+	// no tx room, the hello timer resends it
+	inject_message( port, d_u_addr, d_l_addr, ret ) ;
+}
+
+static void process_rx( xdp_port_t *port, unsigned char *frame, __u32 len ) {
+	struct ethhdr *eth = (struct ethhdr *)frame ;
+	u16 s_u_addr, d_u_addr ;
+	u32 s_l_addr, d_l_addr ;
+	int result ;
+
+	if( len < ETH_HLEN ) return ;
+	s_u_addr = (u16)eth->h_source[0] << 8 | eth->h_source[1] ;
+	s_l_addr = (u32)eth->h_source[2] << 24 | (u32)eth->h_source[3] << 16 | (u32)eth->h_source[4] << 8 | (u32)eth->h_source[5] ;
+	d_u_addr = (u16)eth->h_dest[0] << 8 | eth->h_dest[1] ;
+	d_l_addr = (u32)eth->h_dest[2] << 24 | (u32)eth->h_dest[3] << 16 | (u32)eth->h_dest[4] << 8 | (u32)eth->h_dest[5] ;
+	// only the tokens are ours, data frames to the port have no upper layer here
+	if( !(d_u_addr & ENTL_MESSAGE_ONLY_U) ) return ;
+
+	result = entl_received( &port->stm, s_u_addr, s_l_addr, d_u_addr, d_l_addr ) ;
+
+	if( result == ENTL_ACTION_ERROR || result == ENTL_ACTION_SIG_ERR ) {
+		entl_state_t st, err ;
+		// nobody to signal, clear the error so the hello can start over
+		entl_read_error_state( &port->stm, &st, &err ) ;
+		if( err.error_flag ) printf( "%s error flag %x on state %d\n", port->name, err.error_flag, err.current_state ) ;
+		if( get_entl_state( &port->stm ) == ENTL_STATE_IDLE ) entl_link_up( &port->stm ) ;
+		return ;
+	}
+	port->last_rx_ns = now_ns() ;
+	if( result & ENTL_ACTION_PROC_AIT ) {
+		struct entt_ioctl_ait_data *ait_data = kzalloc( sizeof(struct entt_ioctl_ait_data), GFP_ATOMIC ) ;
+		if( ait_data ) {
+			if( len >= ETH_HLEN + sizeof(u32) ) {
+				memcpy( &ait_data->message_len, frame + ETH_HLEN, sizeof(u32) ) ;
+				if( ait_data->message_len && ait_data->message_len < MAX_AIT_MESSAGE_SIZE && ait_data->message_len <= len - ETH_HLEN - sizeof(u32) ) {
+					memcpy( ait_data->data, frame + ETH_HLEN + sizeof(u32), ait_data->message_len ) ;
+				}
+				else {
+					ait_data->message_len = 0 ;
+				}
+			}
+			entl_new_AIT_message( &port->stm, ait_data ) ;
+		}
+	}
+	if( result & ENTL_ACTION_SEND ) send_token( port ) ;
+}
+
+static void poll_rx( xdp_port_t *port ) {
+	__u32 prod = __atomic_load_n( port->rx.producer, __ATOMIC_ACQUIRE ) ;
+	struct xdp_desc *rx = (struct xdp_desc *)port->rx.ring ;
+	__u64 *fill = (__u64 *)port->fill.ring ;
+	int n = 0 ;
+
+	while( port->rx.cached != prod && n < XDP_RX_BATCH ) {
+		struct xdp_desc *desc = &rx[port->rx.cached & (XDP_RING_SIZE - 1)] ;
+		process_rx( port, port->umem + desc->addr, desc->len ) ;
+		// the frame goes straight back to the fill ring, it has the same number of slots as frames
+		fill[port->fill.cached & (XDP_RING_SIZE - 1)] = desc->addr & ~(__u64)(XDP_FRAME_SIZE - 1) ;
+		port->fill.cached++ ;
+		port->rx.cached++ ;
+		n++ ;
+	}
+	if( n == 0 ) {
+		if( *port->fill.flags & XDP_RING_NEED_WAKEUP ) recvfrom( port->xsk, NULL, 0, MSG_DONTWAIT, NULL, NULL ) ;
+		// let the softirq (or the peer on a veth pair) have the cpu when we share it
+		else sched_yield() ;
+		return ;
+	}
+	port->rx_frames += n ;
+	__atomic_store_n( port->rx.consumer, port->rx.cached, __ATOMIC_RELEASE ) ;
+	__atomic_store_n( port->fill.producer, port->fill.cached, __ATOMIC_RELEASE ) ;
+}
+
+// keep the AIT send queue full, and count what the peer sent us
+static void feed_ait( entl_state_machine_t *stm, int ait_bytes ) {
+	while( entl_num_queued( stm ) < MAX_ENTT_QUEUE_SIZE - 1 ) {
+		struct entt_ioctl_ait_data *ait_data = kzalloc( sizeof(struct entt_ioctl_ait_data), GFP_ATOMIC ) ;
+		if( !ait_data ) return ;
+		ait_data->message_len = ait_bytes ;
+		memset( ait_data->data, 'A', ait_bytes ) ;
+		if( entl_send_AIT_message( stm, ait_data ) < 0 ) {
+			kfree( ait_data ) ;
+			return ;
+		}
+	}
+}
+
+static int run_xdp( char *name, int seconds, int ait_bytes, int queue ) {
+	xdp_port_t *port ;
+	struct ifreq ifr ;
+	unsigned long long start, last_print, last_hello, t ;
+	unsigned long long last_ait = 0, last_bytes = 0 ;
+	u32 last_events = 0 ;
+	entl_state_t st, err ;
+	int sock ;
+
+	port = calloc( 1, sizeof(xdp_port_t) ) ;
+	strncpy( port->name, name, IFNAMSIZ - 1 ) ;
+	port->ifindex = if_nametoindex( name ) ;
+	if( !port->ifindex ) {
+		printf( "no device %s\n", name ) ;
+		return 1 ;
+	}
+	if( (sock = socket( AF_INET, SOCK_DGRAM, 0 )) < 0 ) {
+		perror( "cannot create socket" ) ;
+		return 1 ;
+	}
+	memset( &ifr, 0, sizeof(ifr) ) ;
+	strncpy( ifr.ifr_name, name, sizeof(ifr.ifr_name) - 1 ) ;
+	if( ioctl( sock, SIOCGIFHWADDR, &ifr ) ) {
+		perror( "SIOCGIFHWADDR failed" ) ;
+		return 1 ;
+	}
+	close( sock ) ;
+	memcpy( port->mac, ifr.ifr_hwaddr.sa_data, ETH_ALEN ) ;
+
+	entl_state_machine_init( &port->stm ) ;
+	strncpy( port->stm.name, name, ENTL_DEVICE_NAME_LEN - 1 ) ;
+	entl_set_my_adder( &port->stm, (u16)port->mac[0] << 8 | port->mac[1], (u32)port->mac[2] << 24 | (u32)port->mac[3] << 16 | (u32)port->mac[4] << 8 | (u32)port->mac[5] ) ;
+
+	if( !xdp_attach( port, queue ) ) {
+		xdp_detach( port ) ;
+		return 1 ;
+	}
+	entl_link_up( &port->stm ) ;
+
+	start = last_print = last_hello = now_ns() ;
+	while( running && (seconds == 0 || now_ns() - start < (unsigned long long)seconds * 1000000000ULL) ) {
+		struct entt_ioctl_ait_data *ait_data ;
+
+		poll_rx( port ) ;
+		recycle_tx( port ) ;
+
+		t = now_ns() ;
+		// hello, and the retry when the token got lost
+		if( t - port->last_rx_ns > HELLO_INTERVAL_NS && t - last_hello > HELLO_INTERVAL_NS ) {
+			__u16 u_addr ;
+			__u32 l_addr ;
+			int ret ;
+			last_hello = t ;
+			if( (ret = entl_get_hello( &port->stm, &u_addr, &l_addr )) ) inject_message( port, u_addr, l_addr, ret ) ;
+		}
+
+		if( ait_bytes ) feed_ait( &port->stm, ait_bytes ) ;
+		while( (ait_data = entl_read_AIT_message( &port->stm )) ) {
+			port->ait_received++ ;
+			port->ait_bytes += ait_data->message_len ;
+			kfree( ait_data ) ;
+		}
+
+		if( t - last_print >= 1000000000ULL ) {
+			entl_read_current_state( &port->stm, &st, &err ) ;
+			printf( "%s state %d: %u events/s, %llu AIT/s %llu bytes/s, tx %llu rx %llu tx busy %llu\n", name, st.current_state,
+				st.event_i_know - last_events, port->ait_received - last_ait, port->ait_bytes - last_bytes,
+				port->tx_frames, port->rx_frames, port->tx_busy ) ;
+			last_events = st.event_i_know ;
+			last_ait = port->ait_received ;
+			last_bytes = port->ait_bytes ;
+			last_print = t ;
+		}
+	}
+	xdp_detach( port ) ;
+	return 0 ;
+}
+
+// the same numbers from a port run by the kernel
+static int run_kernel( char *name, int seconds, int ait_bytes ) {
+	struct entl_ioctl_data entl_data ;
+	struct entt_ioctl_ait_data ait_data ;
+	struct ifreq ifr ;
+	unsigned long long start, last_print, t ;
+	unsigned long long ait_received = 0, ait_total = 0, last_ait = 0, last_bytes = 0 ;
+	u32 last_events = 0 ;
+	int sock ;
+
+	if( (sock = socket( AF_INET, SOCK_DGRAM, 0 )) < 0 ) {
+		perror( "cannot create socket" ) ;
+		return 1 ;
+	}
+	memset( &ifr, 0, sizeof(ifr) ) ;
+	strncpy( ifr.ifr_name, name, sizeof(ifr.ifr_name) - 1 ) ;
+
+	start = last_print = now_ns() ;
+	while( running && (seconds == 0 || now_ns() - start < (unsigned long long)seconds * 1000000000ULL) ) {
+		if( ait_bytes ) {
+			// the driver answers with the room left, stop when the queue is full
+			do {
+				memset( &ait_data, 0, sizeof(ait_data) ) ;
+				ait_data.message_len = ait_bytes ;
+				memset( ait_data.data, 'A', ait_bytes ) ;
+				ifr.ifr_data = (char *)&ait_data ;
+				if( ioctl( sock, SIOCDEVPRIVATE_ENTT_SEND_AIT, &ifr ) == -1 ) {
+					printf( "SIOCDEVPRIVATE_ENTT_SEND_AIT failed on %s\n", ifr.ifr_name ) ;
+					return 1 ;
+				}
+			} while( (int)ait_data.num_messages > 0 ) ;
+		}
+		do {
+			ifr.ifr_data = (char *)&ait_data ;
+			if( ioctl( sock, SIOCDEVPRIVATE_ENTT_READ_AIT, &ifr ) == -1 ) {
+				printf( "SIOCDEVPRIVATE_ENTT_READ_AIT failed on %s\n", ifr.ifr_name ) ;
+				return 1 ;
+			}
+			if( ait_data.message_len ) {
+				ait_received++ ;
+				ait_total += ait_data.message_len ;
+			}
+		} while( ait_data.message_len ) ;
+
+		t = now_ns() ;
+		if( t - last_print >= 1000000000ULL ) {
+			memset( &entl_data, 0, sizeof(entl_data) ) ;
+			ifr.ifr_data = (char *)&entl_data ;
+			if( ioctl( sock, SIOCDEVPRIVATE_ENTL_RD_CURRENT, &ifr ) == -1 ) {
+				printf( "SIOCDEVPRIVATE_ENTL_RD_CURRENT failed on %s\n", ifr.ifr_name ) ;
+				return 1 ;
+			}
+			printf( "%s state %d: %u events/s, %llu AIT/s %llu bytes/s\n", name, entl_data.state.current_state,
+				entl_data.state.event_i_know - last_events, ait_received - last_ait, ait_total - last_bytes ) ;
+			last_events = entl_data.state.event_i_know ;
+			last_ait = ait_received ;
+			last_bytes = ait_total ;
+			last_print = t ;
+		}
+		else if( !ait_bytes ) {
+			usleep( 1000 ) ;
+		}
+	}
+	close( sock ) ;
+	return 0 ;
+}
+
+int main( int argc, char *argv[] ) {
+	int kernel = 0, seconds, ait_bytes, queue ;
+	char *name ;
+
+	if( argc > 1 && strcmp( argv[1], "-k" ) == 0 ) {
+		kernel = 1 ;
+		argc-- ;
+		argv++ ;
+	}
+	if( argc > 1 && strcmp( argv[1], "-v" ) == 0 ) {
+		entl_kshim_verbose = 1 ;
+		argc-- ;
+		argv++ ;
+	}
+	if( argc < 2 ) {
+		printf( "%s [-k] [-v] <device name> [seconds] [AIT bytes] [queue]\n", argv[0] ) ;
+		printf( "  -k measures the port run by the kernel driver instead of running it over AF_XDP\n" ) ;
+		printf( "  seconds 0 runs until ^C, AIT bytes 0 sends no AIT messages\n" ) ;
+		return 0 ;
+	}
+	name = argv[1] ;
+	seconds = argc > 2 ? atoi(argv[2]) : 10 ;
+	ait_bytes = argc > 3 ? atoi(argv[3]) : 64 ;
+	queue = argc > 4 ? atoi(argv[4]) : 0 ;
+	if( ait_bytes < 0 || ait_bytes >= MAX_AIT_MESSAGE_SIZE ) ait_bytes = 64 ;
+
+	signal( SIGINT, stop_handler ) ;
+	signal( SIGTERM, stop_handler ) ;
+
+	if( kernel ) return run_kernel( name, seconds, ait_bytes ) ;
+	return run_xdp( name, seconds, ait_bytes, queue ) ;
+}
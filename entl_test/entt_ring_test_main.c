@@ -0,0 +1,142 @@
+/*
+ * ENTT AIT ring tester
+ * Copyright(c) 2016 Earth Computing.
+ *
+ *   Posts AIT messages through the shared-memory send ring and reaps received ones from the recv ring.
+ *   The doorbell ioctl is only used when the driver asks for it, poll() only when the recv ring is empty.
+ */
+
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#include "entl_user_api.h"
+
+#define RING_MASK (ENTT_RING_SIZE - 1)
+
+static int sock;
+static struct ifreq ifr;
+static struct entt_ait_ring_map *map ;
+static int num_doorbells = 0 ;
+static int num_polls = 0 ;
+
+static void ring_doorbell( void ) {
+	num_doorbells++ ;
+	if (ioctl(sock, SIOCDEVPRIVATE_ENTT_RING_DOORBELL, &ifr) == -1) {
+		printf( "SIOCDEVPRIVATE_ENTT_RING_DOORBELL failed on %s\n",ifr.ifr_name );
+	}
+}
+
+// post one message, returns 0 if the ring is full
+static int post_message( char *msg ) {
+	u32 head = __atomic_load_n( &map->send.head, __ATOMIC_ACQUIRE ) ;
+	u32 tail = map->send.tail ;
+	struct entt_ioctl_ait_data *dt ;
+
+	if( tail - head == ENTT_RING_SIZE ) return 0 ;
+	dt = &map->send_ring[tail & RING_MASK] ;
+	dt->message_len = strlen(msg) + 1 ;
+	sprintf( dt->data, "%s", msg ) ;
+	__atomic_store_n( &map->send.tail, tail + 1, __ATOMIC_RELEASE ) ;
+	__atomic_thread_fence( __ATOMIC_SEQ_CST ) ;
+	if( __atomic_load_n( &map->send.flags, __ATOMIC_RELAXED ) & ENTT_RING_F_NEED_WAKEUP ) ring_doorbell() ;
+	return 1 ;
+}
+
+// reap everything in the recv ring, returns number of messages
+static int reap_messages( void ) {
+	u32 head = map->recv.head ;
+	u32 tail = __atomic_load_n( &map->recv.tail, __ATOMIC_ACQUIRE ) ;
+	int count = 0 ;
+
+	while( head != tail ) {
+		struct entt_ioctl_ait_data *dt = &map->recv_ring[head & RING_MASK] ;
+		printf( "AIT message %u : %.*s\n", head, dt->message_len, dt->data ) ;
+		head++ ;
+		count++ ;
+	}
+	__atomic_store_n( &map->recv.head, head, __ATOMIC_RELEASE ) ;
+	__atomic_thread_fence( __ATOMIC_SEQ_CST ) ;
+	// the driver found the ring full and holds more
+	if( count && (__atomic_load_n( &map->recv.flags, __ATOMIC_RELAXED ) & ENTT_RING_F_NEED_WAKEUP) ) ring_doorbell() ;
+	return count ;
+}
+
+int main( int argc, char *argv[] ) {
+	char dev_name[IFNAMSIZ + sizeof(ENTT_RING_DEV_PREFIX) + 8] ;
+	struct pollfd pfd ;
+	int num_send, sent = 0, received = 0 ;
+	int fd ;
+
+	if( argc < 2 ) {
+		printf( "%s needs <device name> (e.g. enp6s0) [number of messages] as the argument\n", argv[0] ) ;
+		return 0 ;
+	}
+	num_send = argc > 2 ? atoi(argv[2]) : 1000 ;
+  	printf( "ENTT ring test on %s.. \n", argv[1] ) ;
+
+	// Creating socet
+	if ((sock = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+		perror("cannot create socket");
+		return 0;
+	}
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, argv[1], sizeof(ifr.ifr_name));
+
+	if (ioctl(sock, SIOCDEVPRIVATE_ENTT_RING_SETUP, &ifr) == -1) {
+		printf( "SIOCDEVPRIVATE_ENTT_RING_SETUP failed on %s\n",ifr.ifr_name );
+		return 0 ;
+	}
+
+	sprintf( dev_name, "/dev/" ENTT_RING_DEV_PREFIX "%s", argv[1] ) ;
+	fd = open( dev_name, O_RDWR ) ;
+	if( fd < 0 ) {
+		perror( dev_name ) ;
+		return 0 ;
+	}
+	map = mmap( NULL, sizeof(struct entt_ait_ring_map), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 ) ;
+	if( map == MAP_FAILED ) {
+		perror( "mmap" ) ;
+		return 0 ;
+	}
+
+	pfd.fd = fd ;
+	while( sent < num_send ) {
+		char data[MAX_AIT_MESSAGE_SIZE] ;
+		sprintf( data, "AIT %s %d", argv[1], sent ) ;
+		if( post_message( data ) ) {
+			sent++ ;
+			received += reap_messages() ;
+			continue ;
+		}
+		// send ring full, wait for the driver to acknowledge
+		pfd.events = POLLOUT | POLLIN ;
+		num_polls++ ;
+		poll( &pfd, 1, 1000 ) ;
+		received += reap_messages() ;
+	}
+
+	// drain what the other side sends for a while
+	while( 1 ) {
+		int n = reap_messages() ;
+		received += n ;
+		if( n ) continue ;
+		pfd.events = POLLIN ;
+		num_polls++ ;
+		if( poll( &pfd, 1, 2000 ) <= 0 ) break ;
+	}
+
+	printf( "sent %d received %d with %d doorbells %d polls\n", sent, received, num_doorbells, num_polls ) ;
+	munmap( map, sizeof(struct entt_ait_ring_map) ) ;
+	close( fd ) ;
+	return 0 ;
+}
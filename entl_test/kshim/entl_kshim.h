@@ -0,0 +1,69 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright © 2016-present Earth Computing Corporation. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE.txt in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+
+// The few kernel services entl_state_machine.c uses, for building it into a user program.
+//   Put this directory first on the include path (cc -I kshim) so its linux/*.h win over the system ones.
+//   The spin locks are real, the state machine may be driven from more than one thread.
+
+#ifndef _ENTL_KSHIM_H_
+#define _ENTL_KSHIM_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <linux/types.h>
+
+typedef uint8_t u8 ;
+typedef uint16_t u16 ;
+typedef uint64_t u64 ;
+
+// ENTL_DEBUG goes to stderr only when the program asks for it, the state machine logs on every transition
+extern int entl_kshim_verbose ;
+
+#define KERN_ALERT ""
+
+static inline int printk( const char *fmt, ... )
+{
+	va_list ap ;
+	int n ;
+
+	if( !entl_kshim_verbose ) return 0 ;
+	va_start( ap, fmt ) ;
+	n = vfprintf( stderr, fmt, ap ) ;
+	va_end( ap ) ;
+	return n ;
+}
+
+typedef pthread_spinlock_t spinlock_t ;
+
+#define spin_lock_init(l) pthread_spin_init( (l), PTHREAD_PROCESS_PRIVATE )
+#define spin_lock_irqsave(l, f) do { (f) = 0 ; pthread_spin_lock( (l) ) ; } while( 0 )
+#define spin_unlock_irqrestore(l, f) do { (void)(f) ; pthread_spin_unlock( (l) ) ; } while( 0 )
+#define spin_unlock(l) pthread_spin_unlock( (l) )
+
+#define GFP_ATOMIC 0
+#define GFP_KERNEL 0
+
+static inline void *kzalloc( size_t size, int flags )
+{
+	(void)flags ;
+	return calloc( 1, size ) ;
+}
+
+#define kfree free
+
+static inline struct timespec current_kernel_time( void )
+{
+	struct timespec ts ;
+
+	clock_gettime( CLOCK_REALTIME_COARSE, &ts ) ;
+	return ts ;
+}
+
+#endif
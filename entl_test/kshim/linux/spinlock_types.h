@@ -0,0 +1 @@
+#include "../entl_kshim.h"